@@ -0,0 +1,46 @@
+/***************************************************************************************
+Access to the delay rings of the effects from their audio callbacks. The per-channel callbacks
+may run concurrently (e.g. as tasks on a CLAP host's thread pool), while AudioBuffer's
+getWritePointer() and copyFrom() also reset the buffer's isClear flag, a plain non-atomic member
+shared by all channels. Through these helpers a callback only touches its own channel's samples.
+****************************************************************************************/
+
+#pragma once
+#include <JuceHeader.h>
+#include <algorithm>
+
+struct DelayRing
+{
+	//************* Zeroes every channel. Unlike AudioBuffer::clear() it leaves isClear false for good: with the flag set, a later ****//
+	//************* clear() would skip the samples written through getWritePointer() below. Not for the audio callbacks. ************//
+
+	static inline void clear(AudioBuffer<float>& ring)
+	{
+		for (auto channel = 0; channel < ring.getNumChannels(); ++channel)
+			std::fill_n(ring.getWritePointer(channel), ring.getNumSamples(), 0.0f);
+	}
+
+
+	//************* The samples of one channel, leaving the buffer object itself untouched. The ring must have been cleared with ******//
+	//************* clear() above (or written through AudioBuffer) since it was allocated. *********************************************//
+
+	static inline float* getWritePointer(AudioBuffer<float>& ring, int channel)
+	{
+		return const_cast<float*>(ring.getReadPointer(channel));
+	}
+
+
+	//************* Copies numSamples samples times gain into a ring of ringSize samples, from writePosition on and wrapping at *******//
+	//************* the end, as AudioBuffer::copyFromWithRamp() with a constant gain would. *****************************************//
+
+	static inline void write(float* ring, int ringSize, int writePosition, const float* source, int numSamples, float gain)
+	{
+		const int untilEnd = jmin(numSamples, ringSize - writePosition);
+
+		for (auto i = 0; i < untilEnd; ++i)
+			ring[writePosition + i] = source[i] * gain;
+
+		for (auto i = untilEnd; i < numSamples; ++i)
+			ring[i - untilEnd] = source[i] * gain;
+	}
+};
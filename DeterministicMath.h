@@ -0,0 +1,47 @@
+/***************************************************************************************
+Helpers for the deterministic mode of the effects: arithmetic whose result does not depend on
+the compiler, the instruction set (SSE, AVX, FMA, NEON) or the C library, so renders are
+bit-identical on every machine.
+****************************************************************************************/
+
+#pragma once
+
+struct DeterministicMath
+{
+	//************* Forces a product to be rounded on its own. Without it, a*b + c may be fused into one FMA on some targets and **//
+	//************* not on others (-ffp-contract), which changes the last bit. The empty asm makes the value opaque to the compiler. //
+
+	static inline float fence(float value)
+	{
+	   #if defined (__GNUC__) && (defined (__x86_64__) || defined (__i386__))
+		asm ("" : "+x" (value));
+	   #elif defined (__GNUC__) && defined (__aarch64__)
+		asm ("" : "+w" (value));
+	   #endif
+		return value;
+	}
+
+
+	//************* sin(2 pi phase) for a phase in [0, 1), without the C library. Reduced to [-pi/2, pi/2] and evaluated with a ****//
+	//************* degree 9 polynomial (error below 4e-6); every operation is rounded in a fixed order. ***************************//
+
+	static inline float sine(float phase)
+	{
+		float x = phase < 0.5f ? phase : phase - 1.0f;
+
+		if (x > 0.25f)
+			x = 0.5f - x;
+		else if (x < -0.25f)
+			x = -0.5f - x;
+
+		const float t = fence(x * 6.28318530718f);
+		const float t2 = fence(t * t);
+
+		float p = 2.75573192e-6f;
+		p = fence(p * t2) - 1.98412698e-4f;
+		p = fence(p * t2) + 8.33333333e-3f;
+		p = fence(p * t2) - 1.66666667e-1f;
+		p = fence(p * t2) + 1.0f;
+		return fence(p * t);
+	}
+};
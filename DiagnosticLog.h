@@ -0,0 +1,242 @@
+/***************************************************************************************
+This class implements a realtime-safe diagnostic log. The effects write small structured records
+(non-finite output, feedback runaway, oversized blocks, bad channel indices, an unrendered
+modulation bus) from inside process() into a preallocated ring. Writing is wait-free and may happen from several audio threads at once.
+A consumer thread formats the records and hands them to an output function, stderr by default.
+****************************************************************************************/
+
+#pragma once
+#include <JuceHeader.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <thread>
+
+#define DEFAULT_DIAGNOSTIC_RECORDS 1024      // ring capacity, rounded up to a power of two
+#define DIAGNOSTIC_WRITE_ATTEMPTS 4          // a writer gives up (and counts a drop) after this many lost races for a slot
+#define DIAGNOSTIC_POLL_INTERVAL_MS 100
+#define DIAGNOSTIC_RUNAWAY_LEVEL 16.0f       // output peak (before device gain) above which a feedback path counts as running away
+
+enum class DiagnosticEvent { nonFiniteOutput, feedbackRunaway, blockTooLarge, channelOutOfRange, modulationBusNotRendered };
+
+struct DiagnosticRecord
+{
+	int64 time;					// steady clock, in nanoseconds
+	const char* source;			// effect name, a string literal
+	const void* instance;
+	DiagnosticEvent event;
+	int channel;
+	float value;				// non-finite sample, runaway peak, block length, channel count or end of the block on the bus
+	float limit;				// largest block that fits, feedback level or samples the bus rendered, if any
+};
+
+
+class DiagnosticLog {
+
+	public :
+
+		DiagnosticLog(int capacity = DEFAULT_DIAGNOSTIC_RECORDS)
+		{
+			size_t size = 1;
+
+			while (size < static_cast<size_t>(jmax(2, capacity)))
+				size *= 2;
+
+			slots.reset(new Slot[size]);
+			mask = size - 1;
+
+			for (size_t i = 0; i < size; ++i)
+				slots[i].sequence.store(i, std::memory_order_relaxed);
+		}
+
+		~DiagnosticLog()
+		{
+			stop();
+		}
+
+
+		//************ Producer side, callable from any number of threads at once. Never blocks, allocates or makes system calls: ******//
+		//************ when the ring is full the record is dropped and counted. *************************************************************//
+
+		void log(const char* source, const void* instance, DiagnosticEvent event, int channel, float value, float limit = 0.0f)
+		{
+			size_t position = writePosition.load(std::memory_order_relaxed);
+
+			for (auto attempt = 0; attempt < DIAGNOSTIC_WRITE_ATTEMPTS; ++attempt)
+			{
+				Slot& slot = slots[position & mask];
+				const auto difference = static_cast<std::ptrdiff_t>(slot.sequence.load(std::memory_order_acquire) - position);
+
+				if (difference < 0)
+					break;												// full: the consumer has not freed this slot yet
+
+				if (difference == 0 && writePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				{
+					slot.record = { now(), source, instance, event, channel, value, limit };
+					slot.sequence.store(position + 1, std::memory_order_release);
+					return;
+				}
+
+				if (difference > 0)
+					position = writePosition.load(std::memory_order_relaxed);		// another writer took it, try the next one
+			}
+
+			droppedRecords.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		uint64_t getDroppedRecords() const
+		{
+			return droppedRecords.load(std::memory_order_relaxed);
+		}
+
+
+		//************ Consumer side, from a single thread: passes every pending record to the callback and returns how many there were **//
+
+		template <typename Callback>
+		int drain(Callback&& callback)
+		{
+			int count = 0;
+
+			for (;; ++readPosition, ++count)
+			{
+				Slot& slot = slots[readPosition & mask];
+
+				if (slot.sequence.load(std::memory_order_acquire) != readPosition + 1)
+					return count;
+
+				const DiagnosticRecord record = slot.record;
+				slot.sequence.store(readPosition + mask + 1, std::memory_order_release);
+				callback(record);
+			}
+		}
+
+
+		//************ Starts a consumer thread that formats the records as text lines and passes them to output (stderr if empty). *****//
+		//************ Use either this thread or drain(), not both. *****************************************************************************//
+
+		void start(std::function<void(const char*)> output = nullptr)
+		{
+			stop();
+
+			emit = output ? std::move(output) : [] (const char* line) { std::fputs(line, stderr); };
+			running.store(true);
+
+			consumer = std::thread([this]
+			{
+				while (running.load())
+				{
+					std::this_thread::sleep_for(std::chrono::milliseconds(DIAGNOSTIC_POLL_INTERVAL_MS));
+					emitPending();
+				}
+
+				emitPending();
+			});
+		}
+
+		void stop()
+		{
+			if (! consumer.joinable())
+				return;
+
+			running.store(false);
+			consumer.join();
+		}
+
+
+		static void format(const DiagnosticRecord& record, char* text, size_t size)
+		{
+			const int length = std::snprintf(text, size, "%s %p channel %d: ", record.source, record.instance, record.channel);
+			char* detail = text + jmin(static_cast<size_t>(jmax(0, length)), size - 1);
+			const size_t remaining = size - static_cast<size_t>(detail - text);
+
+			switch (record.event)
+			{
+				case DiagnosticEvent::nonFiniteOutput:
+					std::snprintf(detail, remaining, "non-finite output (%g)\n", static_cast<double>(record.value));
+					break;
+				case DiagnosticEvent::feedbackRunaway:
+					std::snprintf(detail, remaining, "feedback runaway, peak %g at feedback %g\n", static_cast<double>(record.value), static_cast<double>(record.limit));
+					break;
+				case DiagnosticEvent::blockTooLarge:
+					std::snprintf(detail, remaining, "block of %d samples, at most %d fit the delay ring and the buffer, left unprocessed\n", static_cast<int>(record.value), static_cast<int>(record.limit));
+					break;
+				case DiagnosticEvent::channelOutOfRange:
+					std::snprintf(detail, remaining, "channel index out of range (%d channels), ignored\n", static_cast<int>(record.value));
+					break;
+				case DiagnosticEvent::modulationBusNotRendered:
+					std::snprintf(detail, remaining, "block reaches sample %d of the modulation bus, which rendered %d, own LFO used\n", static_cast<int>(record.value), static_cast<int>(record.limit));
+					break;
+			}
+		}
+
+
+		//************ Largest magnitude in a block, computed on the bit patterns so the loop vectorizes without fast-math. The result **//
+		//************ is infinite or NaN if any sample is, which makes it the one check the effects need for both kinds of anomaly. ****//
+
+		static float getPeakMagnitude(const float* samples, int numSamples)
+		{
+			uint32_t peakBits = 0;
+
+			for (auto i = 0; i < numSamples; ++i)
+			{
+				uint32_t bits;
+				std::memcpy(&bits, samples + i, sizeof(bits));
+				peakBits = jmax(peakBits, bits & 0x7fffffffu);
+			}
+
+			float peak;
+			std::memcpy(&peak, &peakBits, sizeof(peak));
+			return peak;
+		}
+
+		static int64 now()
+		{
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+
+
+	private :
+
+		struct Slot
+		{
+			std::atomic<size_t> sequence{ 0 };		// position + 1 once written, position + capacity once consumed
+			DiagnosticRecord record;
+		};
+
+		void emitPending()
+		{
+			drain([this] (const DiagnosticRecord& record)
+			{
+				char line[256];
+				format(record, line, sizeof(line));
+				emit(line);
+			});
+
+			const uint64_t dropped = droppedRecords.load(std::memory_order_relaxed);
+
+			if (dropped != reportedDrops)
+			{
+				char line[96];
+				std::snprintf(line, sizeof(line), "diagnostic log: %llu records dropped\n", static_cast<unsigned long long>(dropped - reportedDrops));
+				emit(line);
+				reportedDrops = dropped;
+			}
+		}
+
+
+		std::unique_ptr<Slot[]> slots;
+		size_t mask{ 0 };
+		std::atomic<size_t> writePosition{ 0 };
+		size_t readPosition{ 0 };
+		std::atomic<uint64_t> droppedRecords{ 0 };
+		uint64_t reportedDrops{ 0 };
+
+		std::function<void(const char*)> emit;
+		std::thread consumer;
+		std::atomic<bool> running{ false };
+
+};
@@ -0,0 +1,324 @@
+/***************************************************************************************
+Optional tracing of the DSP activity. Every process() call, its stages (filling the delay line,
+rendering the modulation, reading the taps and mixing) and every parameter change are recorded
+with a timestamp into a lock-free ring owned by the calling thread. A background thread drains
+the rings into a Chrome trace file (open it in chrome://tracing or ui.perfetto.dev), so a CPU
+spike can be pinned to the stage and instance that caused it, next to the parameter automation.
+
+Tracing is compiled in only when JUCE_FX_ENABLE_TRACING is defined to 1. Otherwise the macros
+at the bottom expand to nothing and the effects carry no trace code at all.
+****************************************************************************************/
+
+#pragma once
+
+#ifndef JUCE_FX_ENABLE_TRACING
+ #define JUCE_FX_ENABLE_TRACING 0
+#endif
+
+#if JUCE_FX_ENABLE_TRACING
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+
+#define TRACE_RING_EVENTS 8192            // per thread, a power of two. While a ring is full, new events are dropped and counted
+#define MAX_TRACE_THREADS 16              // tracing at the same time; a thread's ring is freed for the next one when it exits
+#define TRACE_FLUSH_INTERVAL_MS 50
+
+class DspTrace {
+
+	public :
+
+		static DspTrace& getInstance()
+		{
+			static DspTrace trace;
+			return trace;
+		}
+
+		~DspTrace()
+		{
+			stop();
+		}
+
+
+		//************ Starts writing a new trace file and the thread that fills it. The rings are allocated on the first start, so ****//
+		//************ call it before the audio threads run. Not realtime safe. ***************************************************************//
+
+		bool start(const std::string& path)
+		{
+			stop();
+
+			file = std::fopen(path.c_str(), "w");
+
+			if (file == nullptr)
+				return false;
+
+			if (rings == nullptr)
+				rings.reset(new Ring[MAX_TRACE_THREADS]);
+
+			for (auto slot = 0; slot < MAX_TRACE_THREADS; ++slot)		// drop whatever a previous session left behind
+			{
+				rings[slot].readIndex.store(rings[slot].writeIndex.load());
+				rings[slot].writtenName = nullptr;
+			}
+
+			session.fetch_add(1);				// threads that found every ring taken try again
+
+			origin = now();
+			firstEvent = true;
+			droppedEvents.store(0);
+			std::fputs("{\"traceEvents\":[\n", file);
+
+			recording.store(true, std::memory_order_release);
+			writer = std::thread([this] { runWriter(); });
+			return true;
+		}
+
+		//************ Stops recording, writes out what is left and closes the file. *****************************************************//
+
+		void stop()
+		{
+			if (file == nullptr)
+				return;
+
+			recording.store(false, std::memory_order_release);
+			writer.join();
+			flush();
+
+			std::fprintf(file, "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"droppedEvents\":\"%llu\"}}\n", static_cast<unsigned long long>(droppedEvents.load()));
+			std::fclose(file);
+			file = nullptr;
+		}
+
+		bool isRecording() const
+		{
+			return recording.load(std::memory_order_acquire);
+		}
+
+
+		//************ Realtime side. name must be a string literal (only the pointer is stored); instance tells the effects apart in ****//
+		//************ the trace. None of these allocate, lock or make system calls. ************************************************************//
+
+		void recordStage(const char* name, const void* instance, int channel, int64 startTime, int64 endTime)
+		{
+			push({ startTime, endTime - startTime, instance, name, static_cast<float>(channel), 'X' });
+		}
+
+		template <typename Value>
+		void recordParameter(const char* name, const void* instance, Value oldValue, Value newValue)
+		{
+			if (oldValue != newValue && isRecording())
+				push({ now(), 0, instance, name, static_cast<float>(newValue), 'C' });
+		}
+
+		void setThreadName(const char* name)
+		{
+			if (Ring* ring = getThreadRing())
+				ring->threadName.store(name, std::memory_order_release);
+		}
+
+		static int64 now()
+		{
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+
+		//************ Times the enclosing scope as one stage (a Chrome "complete" event, so a dropped event never leaves a stage open) ***//
+
+		struct Scope
+		{
+			Scope(const char* name, const void* instance, int channel)
+				: name(name), instance(instance), channel(channel), startTime(getInstance().isRecording() ? now() : -1)
+			{
+
+			}
+
+			~Scope()
+			{
+				if (startTime >= 0)
+					getInstance().recordStage(name, instance, channel, startTime, now());
+			}
+
+			const char* name;
+			const void* instance;
+			int channel;
+			int64 startTime;
+		};
+
+
+
+	private :
+
+		DspTrace()
+		{
+
+		}
+
+		struct Event
+		{
+			int64 time, duration;
+			const void* instance;
+			const char* name;
+			float value;			// the channel of a stage, the new value of a parameter
+			char phase;				// Chrome trace event type: 'X' for stages, 'C' for parameters
+		};
+
+		//************ Single-producer (the thread that owns it) / single-consumer (the writer thread) ring of events ******************//
+
+		struct Ring
+		{
+			Event events[TRACE_RING_EVENTS];
+			std::atomic<size_t> writeIndex{ 0 }, readIndex{ 0 };
+			std::atomic<const char*> threadName{ nullptr };
+			std::atomic<bool> taken{ false };			// owned by a running thread
+			const char* writtenName{ nullptr };			// writer thread only
+		};
+
+		//************ A thread takes a free ring on its first event and hands it back when it exits, so renderers starting new ********//
+		//************ threads for every render do not use up the rings. Sequential owners of a ring share its tid in the trace. ******//
+		//************ Without a free ring the events are dropped, and the thread tries again after the next start(). ****************//
+
+		struct ThreadSlot
+		{
+			int slot{ -1 };
+			unsigned failedSession{ 0 };
+
+			~ThreadSlot()
+			{
+				if (slot >= 0)
+					getInstance().rings[slot].taken.store(false, std::memory_order_release);
+			}
+		};
+
+		Ring* getThreadRing()
+		{
+			thread_local ThreadSlot thread;
+
+			if (thread.slot < 0 && rings != nullptr && thread.failedSession != session.load(std::memory_order_relaxed))
+			{
+				for (auto slot = 0; slot < MAX_TRACE_THREADS && thread.slot < 0; ++slot)
+				{
+					bool expected = false;
+
+					if (rings[slot].taken.compare_exchange_strong(expected, true, std::memory_order_acq_rel))
+					{
+						rings[slot].threadName.store(nullptr, std::memory_order_release);
+						thread.slot = slot;
+					}
+				}
+
+				if (thread.slot < 0)
+					thread.failedSession = session.load(std::memory_order_relaxed);
+			}
+
+			return thread.slot >= 0 ? &rings[thread.slot] : nullptr;
+		}
+
+		void push(const Event& event)
+		{
+			Ring* ring = getThreadRing();
+			const size_t write = ring != nullptr ? ring->writeIndex.load(std::memory_order_relaxed) : 0;
+
+			if (ring == nullptr || write - ring->readIndex.load(std::memory_order_acquire) == TRACE_RING_EVENTS)
+			{
+				droppedEvents.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+
+			ring->events[write & (TRACE_RING_EVENTS - 1)] = event;
+			ring->writeIndex.store(write + 1, std::memory_order_release);
+		}
+
+
+		//************ Writer thread: drains every ring into the file, in Chrome's JSON trace format (times in microseconds) ************//
+
+		void runWriter()
+		{
+			while (recording.load(std::memory_order_acquire))
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(TRACE_FLUSH_INTERVAL_MS));
+				flush();
+			}
+		}
+
+		void flush()
+		{
+			for (auto slot = 0; slot < MAX_TRACE_THREADS; ++slot)
+			{
+				Ring& ring = rings[slot];
+				const char* threadName = ring.threadName.load(std::memory_order_acquire);
+
+				if (threadName != nullptr && threadName != ring.writtenName)
+				{
+					beginEvent();
+					std::fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", slot, threadName);
+					ring.writtenName = threadName;
+				}
+
+				const size_t write = ring.writeIndex.load(std::memory_order_acquire);
+				size_t read = ring.readIndex.load(std::memory_order_relaxed);
+
+				for (; read != write; ++read)
+				{
+					const Event& event = ring.events[read & (TRACE_RING_EVENTS - 1)];
+					const double timestamp = (event.time - origin) * 0.001;
+
+					beginEvent();
+
+					if (event.phase == 'X')
+						std::fprintf(file, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"instance\":\"%p\",\"channel\":%d}}",
+									 event.name, slot, timestamp, event.duration * 0.001, event.instance, static_cast<int>(event.value));
+					else
+						std::fprintf(file, "{\"name\":\"%s\",\"ph\":\"C\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"id\":\"%p\",\"args\":{\"value\":%g}}",
+									 event.name, slot, timestamp, event.instance, static_cast<double>(event.value));
+				}
+
+				ring.readIndex.store(read, std::memory_order_release);
+			}
+
+			std::fflush(file);
+		}
+
+		void beginEvent()
+		{
+			if (! firstEvent)
+				std::fputs(",\n", file);
+
+			firstEvent = false;
+		}
+
+
+		std::unique_ptr<Ring[]> rings;
+		std::atomic<unsigned> session{ 1 };		// start() count; ThreadSlot::failedSession starts at 0, so every thread tries once
+		std::atomic<bool> recording{ false };
+		std::atomic<uint64_t> droppedEvents{ 0 };
+
+		std::FILE* file{ nullptr };
+		std::thread writer;
+		int64 origin{ 0 };
+		bool firstEvent{ true };
+
+};
+
+#define JUCE_FX_TRACE_JOIN_(a, b) a##b
+#define JUCE_FX_TRACE_JOIN(a, b) JUCE_FX_TRACE_JOIN_(a, b)
+
+//************* Use inside member functions: times the rest of the enclosing scope as one stage of this instance, resp. records a ***//
+//************* parameter change (only if the value actually changes, so owners may call the setters every block) ********************//
+
+#define JUCE_FX_TRACE_SCOPE(name, channel)					DspTrace::Scope JUCE_FX_TRACE_JOIN(juceFxTraceScope, __LINE__) (name, this, channel)
+#define JUCE_FX_TRACE_PARAMETER(name, oldValue, newValue)	DspTrace::getInstance().recordParameter(name, this, oldValue, newValue)
+#define JUCE_FX_TRACE_THREAD_NAME(name)						DspTrace::getInstance().setThreadName(name)
+
+#else
+
+// the channel is still referenced (unevaluated), so a parameter only passed to the trace does not become unused
+#define JUCE_FX_TRACE_SCOPE(name, channel)					static_cast<void>(sizeof(channel))
+#define JUCE_FX_TRACE_PARAMETER(name, oldValue, newValue)
+#define JUCE_FX_TRACE_THREAD_NAME(name)
+
+#endif
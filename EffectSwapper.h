@@ -0,0 +1,222 @@
+/***************************************************************************************
+This class implements realtime-safe preset switching for a Flanger or PitchShifter. A new
+configuration (which may need larger delay lines) is built and initialized on a background
+thread, handed to the audio thread through an atomic pointer, takes over the running state
+of the old one (see saveState) and is crossfaded in over a few ms.
+The replaced instance goes back to the background thread to be deleted, so the audio thread
+never allocates or frees.
+****************************************************************************************/
+
+#pragma once
+#include <JuceHeader.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#define DEFAULT_SWAP_CROSSFADE_MS 5.0
+#define RETIRED_INSTANCE_SLOTS 8
+
+template <typename Effect>
+class EffectSwapper {
+
+	public :
+
+		EffectSwapper()
+		{
+
+		}
+
+		~EffectSwapper()
+		{
+			delete current;
+			delete next;
+			delete retiring;
+			delete pending.load();
+			reclaim();
+		}
+
+		EffectSwapper(const EffectSwapper&) = delete;
+		EffectSwapper& operator= (const EffectSwapper&) = delete;
+
+
+		//************* Allocates the crossfade scratch buffer. Call before the audio thread starts, like Effect::initialize. **********//
+
+		void initialize(int SamplesPerBlockExpected, double SampleRate, int numChannels = 2, double crossfadeMilliseconds = DEFAULT_SWAP_CROSSFADE_MS)
+		{
+			scratch.setSize(numChannels, SamplesPerBlockExpected);
+			fadeLength = jmax(1, static_cast<int>(crossfadeMilliseconds * 0.001 * SampleRate));
+		}
+
+
+		//************* Background thread only (one at a time): builds a new instance, lets 'configure' set its parameters, and ******//
+		//************* publishes it. The audio thread picks it up at its next block. A configuration that was published but not ****//
+		//************* picked up yet is simply replaced. Also reclaims instances the audio thread has retired. ***********************//
+
+		template <typename Configure>
+		void prepare(int SamplesPerBlockExpected, double SampleRate, int numChannels, int maxDelayInSamples, Configure configure)
+		{
+			auto instance = std::make_unique<Instance>();
+			instance->effect.initialize(SamplesPerBlockExpected, SampleRate, numChannels);
+			instance->maxDelayInSamples = maxDelayInSamples;
+			instance->state.resize(instance->effect.getStateSize());
+			configure(instance->effect);
+
+			delete pending.exchange(instance.release(), std::memory_order_acq_rel);		// the audio thread never saw a replaced one
+			reclaim();
+		}
+
+		//************* Background thread only: deletes the instances the audio thread has finished with. Call it regularly, e.g. ****//
+		//************* from a timer; prepare() calls it too. *************************************************************************//
+
+		void reclaim()
+		{
+			size_t read = retiredRead.load(std::memory_order_relaxed);
+
+			while (read != retiredWrite.load(std::memory_order_acquire))
+			{
+				delete retired[read % RETIRED_INSTANCE_SLOTS];
+				retiredRead.store(++read, std::memory_order_release);
+			}
+		}
+
+
+		//************* Audio thread: processes all channels of the block and advances the write positions. Until the first ********//
+		//************* configuration arrives the buffer is left untouched. During a crossfade the new instance runs on a copy of ****//
+		//************* the input in the scratch buffer, so numSamples may not exceed the block size passed to initialize(). *********//
+
+		void process(AudioBuffer<float>* buffer, int startSample, int numSamples, float gain)
+		{
+			jassert (numSamples <= scratch.getNumSamples());
+
+			if (retiring != nullptr && retire(retiring))
+				retiring = nullptr;
+
+			if (next == nullptr && retiring == nullptr)
+				takePending();
+
+			if (current == nullptr)
+				return;
+
+			const int numChannels = jmin(buffer->getNumChannels(), scratch.getNumChannels());
+
+			if (next != nullptr)
+				for (auto channel = 0; channel < numChannels; ++channel)
+					scratch.copyFrom(channel, 0, *buffer, channel, startSample, numSamples);
+
+			for (auto channel = 0; channel < numChannels; ++channel)
+				current->effect.process(buffer, startSample, numSamples, current->maxDelayInSamples, channel, gain);
+
+			current->effect.adjustWritePositions(numSamples);
+
+			if (next != nullptr)
+				crossfade(buffer, startSample, numSamples, numChannels, gain);
+		}
+
+		bool isCrossfading() const
+		{
+			return next != nullptr;
+		}
+
+
+
+	private :
+
+		struct Instance
+		{
+			Effect effect;
+			int maxDelayInSamples{ 0 };
+			std::vector<char> state;			// room to take over the state of the instance it replaces
+		};
+
+
+		void takePending()
+		{
+			Instance* incoming = pending.exchange(nullptr, std::memory_order_acq_rel);
+
+			if (incoming == nullptr)
+				return;
+
+			if (current == nullptr)
+				current = incoming;				// nothing to fade from
+			else
+			{
+				next = incoming;
+				fadePosition = 0;
+
+				//******* The new instance continues from the delay lines and modulator phases of the old one, so both produce nearly **//
+				//******* the same signal and the fade is inaudible. If the channel count or sample rate differ, its delay lines ********//
+				//******* are filled first (faded in at weight 0) instead. *****************************************************************//
+
+				const size_t stateSize = current->effect.saveState(next->state.data(), next->state.size());
+
+				if (stateSize == 0 || ! next->effect.restoreState(next->state.data(), stateSize))
+					fadePosition = -(next->maxDelayInSamples + 1);
+			}
+		}
+
+
+		//************* Runs the new instance on the scratch copy and fades the block from the old output to the new one. The new ****//
+		//************* instance takes over once the fade is complete. ******************************************************************//
+
+		void crossfade(AudioBuffer<float>* buffer, int startSample, int numSamples, int numChannels, float gain)
+		{
+			for (auto channel = 0; channel < numChannels; ++channel)
+				next->effect.process(&scratch, 0, numSamples, next->maxDelayInSamples, channel, gain);
+
+			next->effect.adjustWritePositions(numSamples);
+
+			const float step = 1.0f / fadeLength;
+
+			for (auto channel = 0; channel < numChannels; ++channel)
+			{
+				float* out = buffer->getWritePointer(channel, startSample);
+				const float* in = scratch.getReadPointer(channel);
+
+				for (auto sample = 0; sample < numSamples; ++sample)
+				{
+					const float weight = jlimit(0.0f, 1.0f, (fadePosition + sample + 1) * step);
+					out[sample] += weight * (in[sample] - out[sample]);
+				}
+			}
+
+			fadePosition += numSamples;
+
+			if (fadePosition >= fadeLength)
+			{
+				if (! retire(current))
+					retiring = current;			// retire queue full: try again next block, and take no new configuration until then
+
+				current = next;
+				next = nullptr;
+			}
+		}
+
+		//************* Hands an instance to the background thread (single producer/single consumer ring of pointers) **************//
+
+		bool retire(Instance* instance)
+		{
+			const size_t write = retiredWrite.load(std::memory_order_relaxed);
+
+			if (write - retiredRead.load(std::memory_order_acquire) == RETIRED_INSTANCE_SLOTS)
+				return false;
+
+			retired[write % RETIRED_INSTANCE_SLOTS] = instance;
+			retiredWrite.store(write + 1, std::memory_order_release);
+			return true;
+		}
+
+
+		Instance* current{ nullptr };			// owned by the audio thread
+		Instance* next{ nullptr };
+		Instance* retiring{ nullptr };
+		std::atomic<Instance*> pending{ nullptr };
+
+		Instance* retired[RETIRED_INSTANCE_SLOTS]{};
+		alignas(64) std::atomic<size_t> retiredWrite{ 0 };
+		alignas(64) std::atomic<size_t> retiredRead{ 0 };
+
+		AudioBuffer<float> scratch;
+		int fadeLength{ 1 };
+		int fadePosition{ 0 };
+
+};
@@ -0,0 +1,125 @@
+/***************************************************************************************
+This class implements a peak envelope follower with separate attack and release times, one per
+channel, for sidechain driven modulation (ducking, dynamic flanging). The effects run it on the
+sidechain block by block and use the envelope to move their depth, rate or feedback.
+****************************************************************************************/
+
+#pragma once
+#include <JuceHeader.h>
+#include "DeterministicMath.h"
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#define DEFAULT_FOLLOWER_ATTACK_MS 10.0      // time for the envelope to rise by 1 - 1/e of a step
+#define DEFAULT_FOLLOWER_RELEASE_MS 150.0    // time for the envelope to fall by 1 - 1/e once the sidechain stops
+
+class EnvelopeFollower {
+
+	public :
+
+		EnvelopeFollower()
+		{
+
+		}
+
+
+		//************ Allocates the per-channel state. Not realtime safe, call it from the effect's initialize(). *********************//
+
+		void prepare(int numChannels, double SampleRate)
+		{
+			envelopes.assign(jmax(0, numChannels), 0.0f);
+			sampleRate = SampleRate;
+			attackCoefficient = getCoefficient(attackMilliseconds);
+			releaseCoefficient = getCoefficient(releaseMilliseconds);
+		}
+
+		void reset()
+		{
+			std::fill(envelopes.begin(), envelopes.end(), 0.0f);
+		}
+
+		void setAttack(double milliseconds)
+		{
+			attackMilliseconds = milliseconds;
+			attackCoefficient = getCoefficient(milliseconds);
+		}
+
+		void setRelease(double milliseconds)
+		{
+			releaseMilliseconds = milliseconds;
+			releaseCoefficient = getCoefficient(milliseconds);
+		}
+
+		double getAttack() const
+		{
+			return attackMilliseconds;
+		}
+
+		double getRelease() const
+		{
+			return releaseMilliseconds;
+		}
+
+
+		//************ Writes the envelope of numSamples sidechain samples to envelope, continuing from the previous block of the ******//
+		//************ channel. The rectification is one vectorized pass; the smoothing is a recursion and runs per sample. **********//
+
+		template <bool Deterministic>
+		void process(int channel, const float* sidechain, float* envelope, int numSamples)
+		{
+			for (auto i = 0; i < numSamples; ++i)
+			{
+				const float magnitude = std::abs(sidechain[i]);
+				envelope[i] = magnitude <= std::numeric_limits<float>::max() ? magnitude : 0.0f;		// NaN or Inf count as silence
+			}
+
+			float state = envelopes[channel];
+
+			for (auto i = 0; i < numSamples; ++i)
+			{
+				const float input = envelope[i];
+				const float coefficient = input > state ? attackCoefficient : releaseCoefficient;
+
+				if constexpr (Deterministic)
+					state += DeterministicMath::fence(coefficient * (input - state));
+				else
+					state += coefficient * (input - state);
+
+				envelope[i] = state;
+			}
+
+			envelopes[channel] = state < 1.0e-20f ? 0.0f : state;		// long before the release reaches the denormal range
+		}
+
+
+		//************ The running envelopes, for the effects' saveState/restoreState ***************************************************//
+
+		std::vector<float>& getState()
+		{
+			return envelopes;
+		}
+
+		const std::vector<float>& getState() const
+		{
+			return envelopes;
+		}
+
+
+
+	private :
+
+		//************ One-pole coefficient for a time constant, rounded once to float so every machine uses the same value *********//
+
+		float getCoefficient(double milliseconds) const
+		{
+			return milliseconds > 0.0 ? static_cast<float>(1.0 - std::exp(-1000.0 / (milliseconds * sampleRate))) : 1.0f;
+		}
+
+
+		std::vector<float> envelopes;
+		double sampleRate{ 44100.0 };
+		double attackMilliseconds{ DEFAULT_FOLLOWER_ATTACK_MS }, releaseMilliseconds{ DEFAULT_FOLLOWER_RELEASE_MS };
+		float attackCoefficient{ 0.0f }, releaseCoefficient{ 0.0f };
+
+};
@@ -4,7 +4,16 @@ This class implements a flanger algorithm using a FIR comb filter with optional
 
 #pragma once
 #include <JuceHeader.h>
+#include "DelayRing.h"
+#include "DeterministicMath.h"
+#include "DiagnosticLog.h"
+#include "DspTrace.h"
+#include "EnvelopeFollower.h"
+#include "LevelMeter.h"
+#include "ModulationBus.h"
 #define TP_RANGE 0.010
+#define TAIL_DECAY 1.0e-6                 // -120 dB, below which a tail counts as gone (see getTailSamples)
+#define MAX_TAIL_SECONDS 10.0
 
 class Flanger {
 
@@ -16,68 +25,209 @@ class Flanger {
 		}
 
 		
-		//************* Initialization of the delay buffer, hardcoded for 2 channels atm for demonstration purposes*******************//
-		//************* Regarding scalibiltiy, nr. of channels and buffer size should be provided as parameters under GUI control ***//
+		//************* Initialization of the delay buffer. The number of channels defaults to 2 (stereo), but any channel count ***********//
+		//************* can be requested, e.g. when the flanger is scheduled by a TileScheduler over a multichannel buffer ******************//
    
-		void initialize(int SamplesPerBlockExpected, double SampleRate)
+		void initialize(int SamplesPerBlockExpected, double SampleRate, int numChannels = 2)
 		{
 
 			transposition_range = TP_RANGE * SampleRate;
 			delayBufferSize = SamplesPerBlockExpected + transposition_range;		// for safety, allocate enough buffer space to fit tp_range and #expected samples
-			delayBuffer.setSize(2, delayBufferSize);
-			delayBuffer.clear();
+			delayBuffer.setSize(numChannels, delayBufferSize);
+			DelayRing::clear(delayBuffer);
 
-			feedbackBuffer.setSize(2, delayBufferSize);
-			feedbackBuffer.clear();
+			feedbackBuffer.setSize(numChannels, delayBufferSize);
+			DelayRing::clear(feedbackBuffer);
+
+			sinePhase.assign(numChannels, 0.0f);
+			controlSegments.assign(numChannels, ControlSegment());
+			feedbackLowpass.assign(numChannels, 0.0f);
+			sidechainFollower.prepare(numChannels, SampleRate);
+			meter.prepare(numChannels, SampleRate);
+		}
+
+
+		//************* Clears the delay lines and restarts the LFO, without reallocating. Use this to start an unrelated signal. ******//
+
+		void reset()
+		{
+			DelayRing::clear(delayBuffer);
+			DelayRing::clear(feedbackBuffer);
+			std::fill(sinePhase.begin(), sinePhase.end(), 0.0f);
+			std::fill(controlSegments.begin(), controlSegments.end(), ControlSegment());
+			std::fill(feedbackLowpass.begin(), feedbackLowpass.end(), 0.0f);
+			sidechainFollower.reset();
+			meter.reset();
+			delayBufferWritePosition = 0;
+			feedbackBufferWritePosition = 0;
+		}
+
+
+		//************* Snapshot of the running state: the LFO phases, the feedback damping filters, the sidechain envelopes and, per ***//
+		//************* channel, the part of the delay and feedback lines the modulation can still reach. Parameters are not included, *//
+		//************* the owner restores those. The blob does not depend on the block size passed to initialize(), so it can be ******//
+		//************* restored into an instance on another machine (same byte order), but the channel count and sample rate must *****//
+		//************* match. saveState/restoreState never allocate, saveState returns the number of bytes written (0 if the **********//
+		//************* capacity is too small). *****************************************************************************************//
+
+		size_t getStateSize() const
+		{
+			return sizeof(StateHeader) + (sizeof(float) * (3 + 2 * static_cast<size_t>(getLiveLength())) + sizeof(ControlSegment)) * sinePhase.size();
+		}
+
+		size_t saveState(void* destination, size_t capacity) const
+		{
+			if (capacity < getStateSize())
+				return 0;
+
+			const StateHeader header{ stateMagic, static_cast<uint32_t>(sinePhase.size()), static_cast<uint32_t>(getLiveLength()) };
+			char* bytes = static_cast<char*>(destination);
+
+			std::memcpy(bytes, &header, sizeof(header));
+			bytes += sizeof(header);
+			std::memcpy(bytes, sinePhase.data(), sizeof(float) * sinePhase.size());
+			bytes += sizeof(float) * sinePhase.size();
+			std::memcpy(bytes, controlSegments.data(), sizeof(ControlSegment) * controlSegments.size());
+			bytes += sizeof(ControlSegment) * controlSegments.size();
+			std::memcpy(bytes, feedbackLowpass.data(), sizeof(float) * feedbackLowpass.size());
+			bytes += sizeof(float) * feedbackLowpass.size();
+			std::memcpy(bytes, sidechainFollower.getState().data(), sizeof(float) * sidechainFollower.getState().size());
+			bytes += sizeof(float) * sidechainFollower.getState().size();
+
+			for (size_t channel = 0; channel < sinePhase.size(); ++channel)
+				bytes = copyFromRing(delayBuffer.getReadPointer(static_cast<int>(channel)), delayBufferWritePosition, bytes);
+
+			for (size_t channel = 0; channel < sinePhase.size(); ++channel)
+				bytes = copyFromRing(feedbackBuffer.getReadPointer(static_cast<int>(channel)), feedbackBufferWritePosition, bytes);
+
+			return getStateSize();
+		}
+
+		//************* The live region is put back at the start of the rings, and the write positions right after it. Returns false **//
+		//************* (and leaves the state untouched) if the blob was saved by an instance with another configuration. **************//
+
+		bool restoreState(const void* source, size_t size)
+		{
+			StateHeader header;
+
+			if (size != getStateSize())
+				return false;
+
+			const char* bytes = static_cast<const char*>(source);
+			std::memcpy(&header, bytes, sizeof(header));
+			bytes += sizeof(header);
+
+			if (header.magic != stateMagic || header.numChannels != sinePhase.size() || header.liveLength != static_cast<uint32_t>(getLiveLength()))
+				return false;
+
+			std::memcpy(sinePhase.data(), bytes, sizeof(float) * sinePhase.size());
+			bytes += sizeof(float) * sinePhase.size();
+			std::memcpy(controlSegments.data(), bytes, sizeof(ControlSegment) * controlSegments.size());
+			bytes += sizeof(ControlSegment) * controlSegments.size();
+			std::memcpy(feedbackLowpass.data(), bytes, sizeof(float) * feedbackLowpass.size());
+			bytes += sizeof(float) * feedbackLowpass.size();
+			std::memcpy(sidechainFollower.getState().data(), bytes, sizeof(float) * sidechainFollower.getState().size());
+			bytes += sizeof(float) * sidechainFollower.getState().size();
+
+			const size_t regionBytes = sizeof(float) * header.liveLength;
+
+			for (size_t channel = 0; channel < sinePhase.size(); ++channel, bytes += regionBytes)
+				std::memcpy(delayBuffer.getWritePointer(static_cast<int>(channel)), bytes, regionBytes);
+
+			for (size_t channel = 0; channel < sinePhase.size(); ++channel, bytes += regionBytes)
+				std::memcpy(feedbackBuffer.getWritePointer(static_cast<int>(channel)), bytes, regionBytes);
+
+			delayBufferWritePosition = feedbackBufferWritePosition = getLiveLength() % delayBufferSize;
+			return true;
 		}
 
 		//************ Actual DSP callback, applying the flanger to a single channel**********************************************//
 		//************ Hence, when using multi-channel flanger, this function has to be called in a channel loop. ****************//
 		//************ The implementation uses one single delay line that is recombined with the current signal to create the ****//
 		//************ comb-filter effect. We perform linear interpolation on the delay time.*************************************//
+		//************ Only the numSamples samples from startSample on are processed, so a block may be split into several calls **//
+		//************ as long as the write positions are advanced by the length of each call. ***********************************//
 
         void process(AudioBuffer<float>* inbuffer, int startSample, int numSamples, int maxDelayInSamples, int channel, float DeviceGain)						// pass input buffer by reference, get maxDelayInSamples from UI component
         {
-			float* writeBuffer = inbuffer->getWritePointer(channel, startSample);
-			const float* readBuffer =  inbuffer->getReadPointer(channel, startSample);
-			
+			if (! acceptBlock(inbuffer, startSample, numSamples, channel))
+				return;
 
-			const int delayBufferSize = delayBuffer.getNumSamples();
-			fillDelaybuffer(inbuffer->getNumSamples(), channel, delayBufferSize, readBuffer, 1.0);
+			dispatchBlock<0>(inbuffer, startSample, numSamples, maxDelayInSamples, channel, DeviceGain);
 
-			for (auto sample = 0; sample < numSamples; ++sample)
+			checkOutput(inbuffer, startSample, numSamples, channel, DeviceGain);
+        }
 
-			{
-				const float* delay = delayBuffer.getReadPointer(channel, startSample);
-				const float* feedback = feedbackBuffer.getReadPointer(channel, startSample);
+		//************ Same callback with audio-rate modulation from an external source (an envelope follower, another oscillator, ...) ***//
+		//************ instead of stepping setDepth() / setLFO() per sub-block. Each non-null buffer of 'modulation' holds one value per ***//
+		//************ processed sample (index 0 = startSample): delayOffset is added to the LFO delay time (in samples, the sum is ****//
+		//************ clamped to the delay ring), depth replaces the setDepth() value. The LFO keeps running underneath. sidechain is ****//
+		//************ this channel's sidechain signal, whose envelope moves the parameters set with setSidechainModulation(). ***********//
 
-				float delayTime = lfo_sinewave(maxDelayInSamples, channel);
-				int delayTimeInSamples = static_cast<int>(delayTime);
-				float fractionalDelay = delayTime - delayTimeInSamples;
+		struct Modulation
+		{
+			const float* delayOffset{ nullptr };
+			const float* depth{ nullptr };
+			const float* sidechain{ nullptr };
+		};
 
-				int readPosition1 = (delayBufferSize + delayBufferWritePosition - delayTimeInSamples) % delayBufferSize;		          // perform linear interpolation for now
-				int readPosition2 = (delayBufferSize + delayBufferWritePosition - delayTimeInSamples - 1) % delayBufferSize;
+		void process(AudioBuffer<float>* inbuffer, int startSample, int numSamples, int maxDelayInSamples, int channel, float DeviceGain, const Modulation& modulation)
+		{
+			if (! acceptBlock(inbuffer, startSample, numSamples, channel))
+				return;
 
-				float output; 
+			dispatchBlock<0, true>(inbuffer, startSample, numSamples, maxDelayInSamples, channel, DeviceGain, &modulation);
 
-				if (feedbackLevel == 0)
-				{
-					    output = readBuffer[sample] + flangerDepth * ((1.0 - fractionalDelay) * delay[(readPosition1 + sample) % delayBufferSize] + fractionalDelay * delay[(readPosition2 + sample) % delayBufferSize])
-						+ feedbackLevel * ((1.0 - fractionalDelay) * feedback[(readPosition1 + sample) % delayBufferSize] + fractionalDelay * feedback[(readPosition2 + sample) % delayBufferSize]);
-				}
+			checkOutput(inbuffer, startSample, numSamples, channel, DeviceGain);
+		}
 
-				else 
-				{
-					    output = flangerDepth * ((1.0 - fractionalDelay) * delay[(readPosition1 + sample) % delayBufferSize] + fractionalDelay * delay[(readPosition2 + sample) % delayBufferSize])
-						+ feedbackLevel * ((1.0 - fractionalDelay) * feedback[(readPosition1 + sample) % delayBufferSize] + fractionalDelay * feedback[(readPosition2 + sample) % delayBufferSize]);
-				}
-				
-				
-				feedbackBuffer.setSample(channel, (feedbackBufferWritePosition + sample) % delayBufferSize, output);
-				writeBuffer[sample] = DeviceGain*output;
+		//************ Mid/side callback for stereo buffers (channels 0 and 1), replacing the two per-channel process() calls. Left and ****//
+		//************ right are encoded to mid = (L + R) / 2 and side = (L - R) / 2, only the components chosen with ******************//
+		//************ setMidSideComponents() are flanged, and the result is decoded back, all in one loop over the block. Both *********//
+		//************ components share one rendered LFO block; their delay lines are channels 0 and 1 of the rings. Advance the ********//
+		//************ write positions afterwards as usual. Do not mix it with process() calls on the same instance without reset(). ****//
 
+		void processMidSide(AudioBuffer<float>* inbuffer, int startSample, int numSamples, int maxDelayInSamples, float DeviceGain)
+		{
+			if (! acceptBlock(inbuffer, startSample, numSamples, 1))		// needs channels 0 and 1
+				return;
+
+			if (deterministic)
+			{
+				if (metering)
+					processMidSideBlock<true, true>(inbuffer, startSample, numSamples, maxDelayInSamples, DeviceGain);
+				else
+					processMidSideBlock<true, false>(inbuffer, startSample, numSamples, maxDelayInSamples, DeviceGain);
 			}
-        }
+			else
+			{
+				if (metering)
+					processMidSideBlock<false, true>(inbuffer, startSample, numSamples, maxDelayInSamples, DeviceGain);
+				else
+					processMidSideBlock<false, false>(inbuffer, startSample, numSamples, maxDelayInSamples, DeviceGain);
+			}
+
+			checkOutput(inbuffer, startSample, numSamples, 0, DeviceGain);
+			checkOutput(inbuffer, startSample, numSamples, 1, DeviceGain);
+		}
+
+		//************ Same callback for hosts that always deliver blocks of exactly BlockSize samples, e.g. process<256>(...). The trip ***//
+		//************ counts are then compile-time constants and the ring buffer indices wrap with a compare instead of a modulo. *********//
+		//************ BlockSize may not exceed the SamplesPerBlockExpected passed to initialize(). *****************************************//
+
+		template <int BlockSize>
+		void process(AudioBuffer<float>* inbuffer, int startSample, int maxDelayInSamples, int channel, float DeviceGain)
+		{
+			static_assert (BlockSize > 0, "use the runtime overload for variable block sizes");
+			jassert (BlockSize + transposition_range <= delayBufferSize && maxDelayInSamples < transposition_range);
+
+			if (! acceptBlock(inbuffer, startSample, BlockSize, channel))
+				return;
+
+			dispatchBlock<BlockSize>(inbuffer, startSample, BlockSize, maxDelayInSamples, channel, DeviceGain);
+
+			checkOutput(inbuffer, startSample, BlockSize, channel, DeviceGain);
+		}
 
 		//******** This function copies each packet received at the callback into the circular delay buffer. This allows the algorithm***//
 		//******** to use an 'arbitrarily' delayed sample within the transposition range. This way, the LFO modulator****** *************//
@@ -85,17 +235,9 @@ class Flanger {
 
 		void fillDelaybuffer(const int bufferLength, int channel, const int delayBufferLength, const float* bufferData, const float gain)
 		{
-			if (delayBufferLength > bufferLength + delayBufferWritePosition)
-			{
-				delayBuffer.copyFromWithRamp(channel, delayBufferWritePosition, bufferData, bufferLength, gain, gain);
-			}
-			else
-			{
-				const int delayBufferRemaining = delayBufferLength - delayBufferWritePosition;
-				delayBuffer.copyFromWithRamp(channel, delayBufferWritePosition, bufferData, delayBufferRemaining, gain, gain);
-				delayBuffer.copyFromWithRamp(channel, 0, bufferData + delayBufferRemaining, bufferLength - delayBufferRemaining, gain, gain);
+			JUCE_FX_TRACE_SCOPE("Flanger fill delay line", channel);
 
-			}
+			DelayRing::write(DelayRing::getWritePointer(delayBuffer, channel), delayBufferLength, delayBufferWritePosition, bufferData, bufferLength, gain);
 		}
 
 
@@ -104,14 +246,137 @@ class Flanger {
 		
 		float lfo_sinewave(int maxDelayInSamples, int channel)
 		{
-			sinePhase[channel] = sinePhase[channel] + sinefrequency/sampleRate;
+			return lfo_sinewave(maxDelayInSamples, channel, sinefrequency);
+		}
+
+		float lfo_sinewave(int maxDelayInSamples, int channel, float frequency)
+		{
+			sinePhase[channel] = sinePhase[channel] + frequency/sampleRate;
 			if (sinePhase[channel] >= 1) sinePhase[channel] -= 1;
-			return (maxDelayInSamples/2)*(sin(2 * double_Pi * sinePhase[channel])+1);
+			return lfo_value(maxDelayInSamples, sinePhase[channel]);
+		}
+
+		float lfo_value(int maxDelayInSamples, float phase) const
+		{
+			return (maxDelayInSamples/2)*(sin(2 * double_Pi * phase)+1);
+		}
+
+
+		//********* Renders the LFO delay times of one modulation block. At control rate 1 the LFO is evaluated for every sample. ******//
+		//********* Otherwise it is only evaluated every 'controlRate' samples and the delay time is linearly interpolated in between, **//
+		//********* which turns the inner loop into a plain ramp the compiler can vectorize. The phase is still stepped every sample as ****//
+		//********* at control rate 1; one larger step per segment would round differently and drift away from it over time. The LFO *****//
+		//********* runs at 'frequency' (the set rate, or the sidechain modulated one). ***************************************************//
+
+		void renderDelayTimes(float* delayTimes, int numSamples, int maxDelayInSamples, int channel, float frequency)
+		{
+			JUCE_FX_TRACE_SCOPE("Flanger modulation", channel);
+			const int rate = getEffectiveControlRate();
+
+			if (rate == 1)
+			{
+				for (auto sample = 0; sample < numSamples; ++sample)
+					delayTimes[sample] = lfo_sinewave(maxDelayInSamples, channel, frequency);
+				return;
+			}
+
+			const float phaseIncrement = frequency / sampleRate;
+
+			for (auto segmentStart = 0; segmentStart < numSamples; segmentStart += rate)
+			{
+				const int segmentLength = jmin(rate, numSamples - segmentStart);
+				const float startValue = lfo_sinewave(maxDelayInSamples, channel, frequency);
+
+				for (auto i = 1; i < segmentLength; ++i)			// stepped like lfo_sinewave(), so the phase stays bit-identical to control rate 1
+				{
+					sinePhase[channel] = sinePhase[channel] + phaseIncrement;
+					if (sinePhase[channel] >= 1) sinePhase[channel] -= 1;
+				}
+
+				const float endValue = lfo_value(maxDelayInSamples, sinePhase[channel] + phaseIncrement);
+				const float slope = (endValue - startValue) / segmentLength;
+
+				for (auto i = 0; i < segmentLength; ++i)
+					delayTimes[segmentStart + i] = startValue + slope * i;
+			}
+		}
+
+
+		//********* Deterministic version of renderDelayTimes (see setDeterministic). The control points sit at fixed positions of the **//
+		//********* stream (every 'controlRate' samples from the start) instead of restarting with every call, so the output does not ***//
+		//********* depend on how the stream is split into blocks or tiles, and the sine is the library-independent polynomial. *********//
+
+		void renderDelayTimesDeterministic(float* delayTimes, int numSamples, int maxDelayInSamples, int channel, float frequency)
+		{
+			JUCE_FX_TRACE_SCOPE("Flanger modulation", channel);
+			const float phaseIncrement = frequency / sampleRate;
+			ControlSegment& segment = controlSegments[channel];
+
+			for (auto sample = 0; sample < numSamples; ++sample)
+			{
+				sinePhase[channel] = sinePhase[channel] + phaseIncrement;
+				if (sinePhase[channel] >= 1) sinePhase[channel] -= 1;
+
+				if (segment.offset == 0)
+					startControlSegment(segment, sinePhase[channel], phaseIncrement);
+
+				delayTimes[sample] = static_cast<float>(maxDelayInSamples/2) * (segment.start + DeterministicMath::fence(segment.slope * segment.offset));
+
+				if (++segment.offset == segment.length)
+					segment.offset = 0;
+			}
 		}
 
 		
 		
 
+		//********* Moves the LFO to where it would be after samplePosition samples from the start, so a render can begin in the middle *//
+		//********* of a file (e.g. one segment of a split render) and line up with the other segments. The phase is stepped exactly ***//
+		//********* like the modulation renders step it, one add per sample at every control rate, so it matches a continuous render *****//
+		//********* bit for bit. At a control rate above 1 the segments only fall on the same samples as in that render when its blocks **//
+		//********* (and tiles) and samplePosition are multiples of the control rate. ******************************************************//
+
+		void setModulatorPosition(int64 samplePosition)
+		{
+			float phase = 0.0f;
+			ControlSegment segment;
+			const int rate = getEffectiveControlRate();
+			const int64 segmentStart = samplePosition - samplePosition % rate;		// in deterministic mode, the control segment we seek into
+
+			for (int64 sample = 0; sample < samplePosition; ++sample)
+			{
+				phase = phase + sinefrequency/sampleRate;
+				if (phase >= 1) phase -= 1;
+
+				if (sample == segmentStart && deterministic)
+					startControlSegment(segment, phase, sinefrequency/sampleRate);
+			}
+
+			segment.offset = static_cast<int>(samplePosition - segmentStart);
+			std::fill(sinePhase.begin(), sinePhase.end(), phase);
+			std::fill(controlSegments.begin(), controlSegments.end(), segment);
+		}
+
+
+		//********* Samples the flanger keeps ringing after its input stops: one delay line length, plus one line length for every trip **//
+		//********* around the feedback loop until the feedback has decayed by TAIL_DECAY. A loop that does not decay (a saturated ********//
+		//********* feedback of 1 or more) is capped at MAX_TAIL_SECONDS. Used as the pre-roll of split renders (see RenderFarm). *********//
+
+		int64 getTailSamples() const
+		{
+			const float loopGain = std::abs(feedbackLevel);
+			const int64 longestTail = static_cast<int64>(MAX_TAIL_SECONDS * sampleRate);
+
+			if (! (loopGain < 1))
+				return longestTail;
+
+			const int64 trips = loopGain > 0 ? static_cast<int64>(std::ceil(std::log(TAIL_DECAY) / std::log(loopGain))) : 0;
+			return jmin(longestTail, static_cast<int64>(transposition_range) * (1 + trips));
+		}
+
+
+
+
 		//************ To update the write index of the delay buffer after storing a packet in the callback. We don't do this in the fillDelayBuffer ** //
 		//************ as we can only adjust it after each channel has been copied. Hence, it has to be called by the owning class after the channel loop *//
 		//************ has completed **********************************************************************************************************************//
@@ -136,35 +401,680 @@ class Flanger {
 
 
 
+		//************ Advances both write indices at once, for owners that treat every effect alike (see TileScheduler). *****************************//
+
+
+		void adjustWritePositions(int numsamplesInBuffer)
+		{
+			adjustDelayBufferWritePosition(numsamplesInBuffer);
+			adjustFeedBackBufferWritePosition(numsamplesInBuffer);
+		}
+
+
+
+
 		//**********  Setter member functions for GUI controlled owner of the flanger object *************************************************************//
 
 
 		void setDepth(float depth)
 		{
+			JUCE_FX_TRACE_PARAMETER("Flanger depth", flangerDepth, depth);
 			flangerDepth = depth;
 		}
 
 		void setFeedback(float feedback)
 		{
+			JUCE_FX_TRACE_PARAMETER("Flanger feedback", feedbackLevel, feedback);
 			feedbackLevel = feedback;
 		}
 
+		//**********  Shaping of the signal fed back into the delay line. Damping (0 = off, towards 1 = darker) runs it through a one-pole **//
+		//**********  lowpass, so the high end dies out first as in a tape or bucket-brigade flanger. Saturation passes it through a soft ****//
+		//**********  clipper that never exceeds 1, which keeps the loop bounded even at feedback levels of 1 and above. ********************//
+
+		void setFeedbackDamping(float damping)
+		{
+			JUCE_FX_TRACE_PARAMETER("Flanger feedback damping", feedbackDamping, jlimit(0.0f, 0.99f, damping));
+			feedbackDamping = jlimit(0.0f, 0.99f, damping);
+		}
+
+		void setFeedbackSaturation(bool shouldSaturate)
+		{
+			JUCE_FX_TRACE_PARAMETER("Flanger feedback saturation", feedbackSaturation, shouldSaturate);
+			feedbackSaturation = shouldSaturate;
+		}
+
 		void setLFO(float rate)
 		{
+			JUCE_FX_TRACE_PARAMETER("Flanger rate", sinefrequency, rate);
 			sinefrequency = rate;
 		}
 
+		//**********  Sidechain modulation (see Modulation::sidechain): the envelope of the sidechain (about 0 to 1 for a full scale ******//
+		//**********  signal) times each amount is added to the depth, the LFO rate in Hz and the feedback. Negative amounts duck. Depth ***//
+		//**********  and feedback follow the envelope per sample, the rate follows its average over each modulation block; in *************//
+		//**********  deterministic mode a sidechain driven rate is therefore only reproducible for the same block sizes. ********************//
+
+		void setSidechainModulation(float depthAmount, float rateAmount, float feedbackAmount)
+		{
+			sidechainDepth = depthAmount;
+			sidechainRate = rateAmount;
+			sidechainFeedback = feedbackAmount;
+		}
+
+		void setSidechainFollower(double attackMilliseconds, double releaseMilliseconds)
+		{
+			sidechainFollower.setAttack(attackMilliseconds);
+			sidechainFollower.setRelease(releaseMilliseconds);
+		}
+
+		//**********  Takes the LFO from a shared ModulationBus instead of rendering one (nullptr to go back to the own LFO). lfo is the ****//
+		//**********  index from ModulationBus::getLFO(); an invalid one (its -1 when the bus is full) is ignored. phaseOffset is in *****//
+		//**********  cycles and scale (-1 to 1) sets how much of the sweep is used. The bus sets the rate, so setLFO() and a sidechain ***//
+		//**********  driven rate have no effect while subscribed. The offline renderers (OfflineRenderer, RenderFarm, RenderSession, ****//
+		//**********  RenderCache) render no bus and refuse subscribed instances. ***********************************************************//
+
+		void setModulationBus(const ModulationBus* bus, int lfo = 0, float phaseOffset = 0.0f, float scale = 1.0f)
+		{
+			jassert (bus == nullptr || bus->isValidLFO(lfo));			// e.g. getLFO() returned -1: all bus LFOs are taken
+
+			if (bus != nullptr && ! bus->isValidLFO(lfo))
+				return;
+
+			modulationBus = bus;
+			busLFO = lfo;
+			busPhaseOffset = phaseOffset - std::floor(phaseOffset);
+			busScale = jlimit(-1.0f, 1.0f, scale);
+
+			float quarter = busPhaseOffset + 0.25f;
+			if (quarter >= 1) quarter -= 1;
+
+			busSineWeight = DeterministicMath::fence(busScale * DeterministicMath::sine(quarter));				// scale * cos(offset)
+			busCosineWeight = DeterministicMath::fence(busScale * DeterministicMath::sine(busPhaseOffset));		// scale * sin(offset)
+		}
+
+		const ModulationBus* getModulationBus() const
+		{
+			return modulationBus;
+		}
+
+		void setMidSideComponents(bool flangeMid, bool flangeSide)										// for processMidSide(), by default only the side is flanged
+		{
+			midSideComponents[0] = flangeMid;
+			midSideComponents[1] = flangeSide;
+		}
+
+		void setControlRate(int samplesPerControlPoint)													// 1 = LFO at audio rate, e.g. 16 or 32 for control rate
+		{
+			JUCE_FX_TRACE_PARAMETER("Flanger control rate", controlRate, jmax(1, samplesPerControlPoint));
+			controlRate = jmax(1, samplesPerControlPoint);
+		}
+
+		//**********  Quality tiers for overload handling (see LoadGovernor). Tier 0 runs as configured, higher tiers evaluate the LFO *****//
+		//**********  at a coarser control rate. The phase stays exact, so the tier may change between any two blocks without a click. ******//
+
+		static constexpr int numQualityTiers = 3;
+
+		void setQualityTier(int tier)
+		{
+			JUCE_FX_TRACE_PARAMETER("Flanger quality tier", qualityTier, jlimit(0, numQualityTiers - 1, tier));
+			qualityTier = jlimit(0, numQualityTiers - 1, tier);
+		}
+
+		int getQualityTier() const
+		{
+			return qualityTier;
+		}
+
+
+		//**********  Deterministic mode: the output is bit-identical whatever the compiler flags, instruction set (SSE, AVX, FMA), C *****//
+		//**********  library, block size or tiling, for audits and render caches. It uses a polynomial sine instead of sin(), rounds *****//
+		//**********  every product on its own (no FMA contraction) and anchors the control points to the stream (see ******************//
+		//**********  renderDelayTimesDeterministic). Its output differs slightly from the default mode. Set it before processing starts. *//
+
+		void setDeterministic(bool shouldBeDeterministic)
+		{
+			deterministic = shouldBeDeterministic;
+		}
+
+
+		//**********  Reports anomalies found in process() to the log (nullptr to stop). Blocks larger than the configured size and ********//
+		//**********  invalid channel indices are always skipped, with or without a log; the output checks only run with one. ***************//
+
+		void setDiagnosticLog(DiagnosticLog* log)
+		{
+			diagnosticLog = log;
+		}
+
+
+		//**********  Output metering: with it on, the sample loop also tracks each channel's peak and RMS, and publishes them once per *****//
+		//**********  block. getOutputMeter().getPeak(channel) / getRms(channel) may then be read from any thread. ****************************//
+
+		void setMetering(bool shouldMeter)
+		{
+			metering = shouldMeter;
+		}
+
+		const LevelMeter& getOutputMeter() const
+		{
+			return meter;
+		}
+
+
+		//**********  Feeds every setting that shapes the output into a hasher (see RenderCache), so renders can be identified by content ****//
+
+		template <typename Hasher>
+		void hashSettings(Hasher& hasher) const
+		{
+			hasher.add("Flanger");
+			hasher.add(transposition_range);				// the only part of the initialize() configuration that reaches the output
+			hasher.add(midSideComponents[0]);
+			hasher.add(midSideComponents[1]);
+			hasher.add(sinefrequency);
+			hasher.add(flangerDepth);
+			hasher.add(feedbackLevel);
+			hasher.add(getEffectiveControlRate());
+			hasher.add(deterministic);
+			hasher.add(feedbackDamping);
+			hasher.add(feedbackSaturation);
+			hasher.add(sidechainDepth);
+			hasher.add(sidechainRate);
+			hasher.add(sidechainFeedback);
+			hasher.add(sidechainFollower.getAttack());
+			hasher.add(sidechainFollower.getRelease());
+			hasher.add(modulationBus != nullptr ? modulationBus->getFrequency(busLFO) : -1.0f);
+			hasher.add(busPhaseOffset);
+			hasher.add(busScale);
+		}
+
 		
 
 
 
 	private :
 
-		float sinePhase[2]{ 0.0,0.0 };
+		static constexpr int modulationBlockSize = 256;	// the LFO is rendered in blocks of at most this many samples
+
+
+		//************ Picks the kernel variant for the current modes, so the per-sample loop carries no runtime mode checks ****************//
+
+		template <int BlockSize, bool Modulated = false>
+		void dispatchBlock(AudioBuffer<float>* inbuffer, int startSample, int numSamples, int maxDelayInSamples, int channel, float DeviceGain, const Modulation* modulation = nullptr)
+		{
+			if (deterministic)
+			{
+				if (metering)
+					processBlock<BlockSize, true, true, Modulated>(inbuffer, startSample, numSamples, maxDelayInSamples, channel, DeviceGain, modulation);
+				else
+					processBlock<BlockSize, true, false, Modulated>(inbuffer, startSample, numSamples, maxDelayInSamples, channel, DeviceGain, modulation);
+			}
+			else
+			{
+				if (metering)
+					processBlock<BlockSize, false, true, Modulated>(inbuffer, startSample, numSamples, maxDelayInSamples, channel, DeviceGain, modulation);
+				else
+					processBlock<BlockSize, false, false, Modulated>(inbuffer, startSample, numSamples, maxDelayInSamples, channel, DeviceGain, modulation);
+			}
+		}
+
+
+		//************ The actual flanger kernel. BlockSize 0 means the block size is only known at runtime (numSamples). *****************//
+
+		template <int BlockSize, bool Deterministic, bool Metering, bool Modulated>
+		void processBlock(AudioBuffer<float>* inbuffer, int startSample, int numSamples, int maxDelayInSamples, int channel, float DeviceGain, const Modulation* modulation)
+		{
+			if constexpr (BlockSize > 0)
+				numSamples = BlockSize;
+
+			JUCE_FX_TRACE_SCOPE("Flanger process", channel);
+
+			float* writeBuffer = inbuffer->getWritePointer(channel, startSample);
+			const float* readBuffer =  inbuffer->getReadPointer(channel, startSample);
+			
+
+			const int delayBufferSize = delayBuffer.getNumSamples();
+			fillDelaybuffer(numSamples, channel, delayBufferSize, readBuffer, 1.0);
+
+			const float* delay = delayBuffer.getReadPointer(channel);
+			const float* feedback = feedbackBuffer.getReadPointer(channel);
+			float* feedbackWrite = DelayRing::getWritePointer(feedbackBuffer, channel);
+			float delayTimes[modulationBlockSize], depths[modulationBlockSize], feedbackGains[modulationBlockSize], envelope[modulationBlockSize];
+			float peak = 0.0f, sumOfSquares = 0.0f;
+			const bool shapeFeedback = feedbackDamping > 0 || feedbackSaturation;
+			float lowpass = feedbackLowpass[channel];
+
+			for (auto blockStart = 0; blockStart < numSamples; blockStart += modulationBlockSize)
+			{
+				const int blockLength = jmin(modulationBlockSize, numSamples - blockStart);
+				float frequency = sinefrequency;
+
+				if constexpr (Modulated)
+					frequency = followSidechain<Deterministic>(*modulation, blockStart, blockLength, channel, envelope);
+
+				renderModulationBlock<Deterministic>(delayTimes, startSample + blockStart, blockLength, maxDelayInSamples, channel, frequency);
+
+				if constexpr (Modulated)
+					applyModulation<Deterministic>(*modulation, blockStart, blockLength, envelope, delayTimes, depths, feedbackGains);
+
+				JUCE_FX_TRACE_SCOPE("Flanger taps and mix", channel);
+
+				for (auto i = 0; i < blockLength; ++i)
+				{
+					const int sample = blockStart + i;
+
+					float delayTime = delayTimes[i];
+					int delayTimeInSamples = static_cast<int>(delayTime);
+					float fractionalDelay = delayTime - delayTimeInSamples;
+
+					int readPosition1 = ringIndex<BlockSize>(delayBufferWritePosition + sample - delayTimeInSamples, delayBufferSize);		          // perform linear interpolation for now
+					int readPosition2 = ringIndex<BlockSize>(delayBufferWritePosition + sample - delayTimeInSamples - 1, delayBufferSize);
+					int feedbackPosition1 = delayTimeInSamples > 0 ? readPosition1 : readPosition2;		// below one sample of delay, readPosition1 is the feedback sample not written yet
+
+					const float depth = Modulated ? depths[i] : flangerDepth;
+					const float feedbackGain = Modulated ? feedbackGains[i] : feedbackLevel;
+					const float output = flangeSample<Deterministic>(delay, feedback, readBuffer[sample], fractionalDelay, readPosition1, readPosition2, feedbackPosition1, depth, feedbackGain);
+
+					feedbackWrite[ringIndex<BlockSize>(feedbackBufferWritePosition + sample, delayBufferSize)] = shapeFeedback ? shapeFeedbackSample<Deterministic>(output, lowpass) : output;
+					writeBuffer[sample] = DeviceGain*output;
+
+					if constexpr (Metering)
+					{
+						peak = jmax(peak, std::abs(writeBuffer[sample]));
+						sumOfSquares += writeBuffer[sample] * writeBuffer[sample];
+					}
+				}
+			}
+
+			feedbackLowpass[channel] = lowpass;
+
+			if constexpr (Metering)
+				meter.publish(channel, peak, sumOfSquares, numSamples);
+		}
+
+
+		//************ The mid/side kernel. Both delay lines are written in the loop itself (a tap may read the current sample), and the *****//
+		//************ component that is not flanged still goes through them, so switching components later does not click. *************//
+
+		template <bool Deterministic, bool Metering>
+		void processMidSideBlock(AudioBuffer<float>* inbuffer, int startSample, int numSamples, int maxDelayInSamples, float DeviceGain)
+		{
+			JUCE_FX_TRACE_SCOPE("Flanger mid/side process", -1);
+
+			float* left = inbuffer->getWritePointer(0, startSample);
+			float* right = inbuffer->getWritePointer(1, startSample);
+			float* delays[2] = { DelayRing::getWritePointer(delayBuffer, 0), DelayRing::getWritePointer(delayBuffer, 1) };
+			float* feedbacks[2] = { DelayRing::getWritePointer(feedbackBuffer, 0), DelayRing::getWritePointer(feedbackBuffer, 1) };
+			const bool flangeMid = midSideComponents[0], flangeSide = midSideComponents[1];
+
+			float delayTimes[modulationBlockSize];
+			float peak[2] = { 0.0f, 0.0f }, sumOfSquares[2] = { 0.0f, 0.0f };
+			const bool shapeFeedback = feedbackDamping > 0 || feedbackSaturation;
+			float lowpass[2] = { feedbackLowpass[0], feedbackLowpass[1] };
+
+			for (auto blockStart = 0; blockStart < numSamples; blockStart += modulationBlockSize)
+			{
+				const int blockLength = jmin(modulationBlockSize, numSamples - blockStart);
+				renderModulationBlock<Deterministic>(delayTimes, startSample + blockStart, blockLength, maxDelayInSamples, 0, sinefrequency);
+
+				JUCE_FX_TRACE_SCOPE("Flanger mid/side taps and mix", -1);
+
+				for (auto i = 0; i < blockLength; ++i)
+				{
+					const int sample = blockStart + i;
+
+					float delayTime = delayTimes[i];
+					int delayTimeInSamples = static_cast<int>(delayTime);
+					float fractionalDelay = delayTime - delayTimeInSamples;
+
+					int writePosition = ringIndex<0>(delayBufferWritePosition + sample, delayBufferSize);
+					int feedbackWritePosition = ringIndex<0>(feedbackBufferWritePosition + sample, delayBufferSize);
+					int readPosition1 = ringIndex<0>(delayBufferWritePosition + sample - delayTimeInSamples, delayBufferSize);
+					int readPosition2 = ringIndex<0>(delayBufferWritePosition + sample - delayTimeInSamples - 1, delayBufferSize);
+					int feedbackPosition1 = delayTimeInSamples > 0 ? readPosition1 : readPosition2;
+
+					float mid = 0.5f * (left[sample] + right[sample]);
+					float side = 0.5f * (left[sample] - right[sample]);
+
+					delays[0][writePosition] = mid;
+					delays[1][writePosition] = side;
+
+					if (flangeMid)
+						mid = flangeSample<Deterministic>(delays[0], feedbacks[0], mid, fractionalDelay, readPosition1, readPosition2, feedbackPosition1, flangerDepth, feedbackLevel);
+
+					if (flangeSide)
+						side = flangeSample<Deterministic>(delays[1], feedbacks[1], side, fractionalDelay, readPosition1, readPosition2, feedbackPosition1, flangerDepth, feedbackLevel);
+
+					feedbacks[0][feedbackWritePosition] = shapeFeedback ? shapeFeedbackSample<Deterministic>(mid, lowpass[0]) : mid;
+					feedbacks[1][feedbackWritePosition] = shapeFeedback ? shapeFeedbackSample<Deterministic>(side, lowpass[1]) : side;
+
+					left[sample] = DeviceGain * (mid + side);
+					right[sample] = DeviceGain * (mid - side);
+
+					if constexpr (Metering)
+					{
+						peak[0] = jmax(peak[0], std::abs(left[sample]));
+						peak[1] = jmax(peak[1], std::abs(right[sample]));
+						sumOfSquares[0] += left[sample] * left[sample];
+						sumOfSquares[1] += right[sample] * right[sample];
+					}
+				}
+			}
+
+			sinePhase[1] = sinePhase[0];					// keep the LFOs in step for later per-channel processing
+			controlSegments[1] = controlSegments[0];
+			feedbackLowpass[0] = lowpass[0];
+			feedbackLowpass[1] = lowpass[1];
+
+			if constexpr (Metering)
+			{
+				meter.publish(0, peak[0], sumOfSquares[0], numSamples);
+				meter.publish(1, peak[1], sumOfSquares[1], numSamples);
+			}
+		}
+
+
+		//************ The delay times of one modulation block, from the modulation bus if one is set and has rendered this part of the **//
+		//************ host block, otherwise from the own LFO. Falling back is an error of the owner (acceptBlock() logs it): the sweep ***//
+		//************ jumps, and a bus rendered for an earlier, longer block is read from without notice. ********************************//
+
+		template <bool Deterministic>
+		void renderModulationBlock(float* delayTimes, int busPosition, int blockLength, int maxDelayInSamples, int channel, float frequency)
+		{
+			if (modulationBus != nullptr)
+			{
+				jassert (busPosition + blockLength <= modulationBus->getNumSamples());		// render() the bus for the host block first
+
+				if (busPosition + blockLength <= modulationBus->getNumSamples())
+					return renderBusDelayTimes<Deterministic>(delayTimes, busPosition, blockLength, maxDelayInSamples, channel);
+			}
+
+			if constexpr (Deterministic)
+				renderDelayTimesDeterministic(delayTimes, blockLength, maxDelayInSamples, channel, frequency);
+			else
+				renderDelayTimes(delayTimes, blockLength, maxDelayInSamples, channel, frequency);
+		}
+
+		//************ Delay times from the bus LFO's sine / cosine pair: scale * sin(bus phase + offset) = sine * scale cos(offset) + *****//
+		//************ cosine * scale sin(offset), mapped onto 0 .. maxDelayInSamples like lfo_value(). One vectorized pass, no sine. ****//
+
+		template <bool Deterministic>
+		void renderBusDelayTimes(float* delayTimes, int busPosition, int blockLength, int maxDelayInSamples, int channel) const
+		{
+			JUCE_FX_TRACE_SCOPE("Flanger bus modulation", channel);
+			const float* sine = modulationBus->getSine(busLFO) + busPosition;
+			const float* cosine = modulationBus->getCosine(busLFO) + busPosition;
+			const float halfRange = static_cast<float>(maxDelayInSamples/2);
+
+			for (auto i = 0; i < blockLength; ++i)
+			{
+				if constexpr (Deterministic)
+					delayTimes[i] = DeterministicMath::fence(halfRange * (DeterministicMath::fence(sine[i] * busSineWeight) + DeterministicMath::fence(cosine[i] * busCosineWeight) + 1.0f));
+				else
+					delayTimes[i] = halfRange * (sine[i] * busSineWeight + cosine[i] * busCosineWeight + 1.0f);
+			}
+		}
+
+
+		//************ One output sample of the comb filter, from the two taps around the delay time on the delay and feedback lines. *******//
+		//************ Whether the dry signal is mixed in depends on the set feedback level, not on the (possibly modulated) gain. *********//
+
+		template <bool Deterministic>
+		float flangeSample(const float* delay, const float* feedback, float dry, float fractionalDelay, int readPosition1, int readPosition2, int feedbackPosition1, float depth, float feedbackGain) const
+		{
+			if constexpr (Deterministic)
+			{
+				const float weight1 = 1.0f - fractionalDelay;
+				const float delayed = DeterministicMath::fence(weight1 * delay[readPosition1]) + DeterministicMath::fence(fractionalDelay * delay[readPosition2]);
+				const float fedBack = DeterministicMath::fence(weight1 * feedback[feedbackPosition1]) + DeterministicMath::fence(fractionalDelay * feedback[readPosition2]);
+
+				return (feedbackLevel == 0 ? dry : 0.0f) + DeterministicMath::fence(depth * delayed) + DeterministicMath::fence(feedbackGain * fedBack);
+			}
+
+			else if (feedbackLevel == 0)
+			{
+				    return dry + depth * ((1.0 - fractionalDelay) * delay[readPosition1] + fractionalDelay * delay[readPosition2])
+					+ feedbackGain * ((1.0 - fractionalDelay) * feedback[feedbackPosition1] + fractionalDelay * feedback[readPosition2]);
+			}
+
+			else
+			{
+				    return depth * ((1.0 - fractionalDelay) * delay[readPosition1] + fractionalDelay * delay[readPosition2])
+					+ feedbackGain * ((1.0 - fractionalDelay) * feedback[feedbackPosition1] + fractionalDelay * feedback[readPosition2]);
+			}
+		}
+
+
+		//************ Runs the sidechain envelope follower over one modulation block and returns the LFO rate for that block (the set ***//
+		//************ rate plus the block's average envelope times the rate amount). Without a sidechain the set rate is returned. ********//
+
+		template <bool Deterministic>
+		float followSidechain(const Modulation& modulation, int blockStart, int blockLength, int channel, float* envelope)
+		{
+			if (modulation.sidechain == nullptr)
+				return sinefrequency;
+
+			sidechainFollower.process<Deterministic>(channel, modulation.sidechain + blockStart, envelope, blockLength);
+
+			float sum = 0.0f;
+
+			for (auto i = 0; i < blockLength; ++i)
+				sum += envelope[i];
+
+			if constexpr (Deterministic)
+				return jmax(0.0f, sinefrequency + DeterministicMath::fence(sidechainRate * (sum / blockLength)));
+			else
+				return jmax(0.0f, sinefrequency + sidechainRate * (sum / blockLength));
+		}
+
+
+		//************ Applies one modulation block of the external buffers: the delay offsets are added and the sum clamped to what ******//
+		//************ the ring holds (also when an offset is NaN, so a bad source cannot index outside it), the depths are copied and ****//
+		//************ the sidechain envelope is added to depth and feedback. Plain passes the compiler vectorizes, outside the ***********//
+		//************ per-sample loop. ******************************************************************************************************//
+
+		template <bool Deterministic>
+		void applyModulation(const Modulation& modulation, int blockStart, int blockLength, const float* envelope, float* delayTimes, float* depths, float* feedbackGains) const
+		{
+			const float longestDelay = static_cast<float>(transposition_range - 1);
+
+			if (modulation.delayOffset != nullptr)
+				for (auto i = 0; i < blockLength; ++i)
+				{
+					const float delayTime = delayTimes[i] + modulation.delayOffset[blockStart + i];
+					delayTimes[i] = delayTime > 0.0f ? (delayTime < longestDelay ? delayTime : longestDelay) : 0.0f;		// NaN compares false: no delay
+				}
+
+			if (modulation.depth != nullptr)
+				std::copy(modulation.depth + blockStart, modulation.depth + blockStart + blockLength, depths);
+			else
+				std::fill(depths, depths + blockLength, flangerDepth);
+
+			std::fill(feedbackGains, feedbackGains + blockLength, feedbackLevel);
+
+			if (modulation.sidechain == nullptr)
+				return;
+
+			for (auto i = 0; i < blockLength; ++i)
+			{
+				if constexpr (Deterministic)
+				{
+					depths[i] += DeterministicMath::fence(sidechainDepth * envelope[i]);
+					feedbackGains[i] += DeterministicMath::fence(sidechainFeedback * envelope[i]);
+				}
+				else
+				{
+					depths[i] += sidechainDepth * envelope[i];
+					feedbackGains[i] += sidechainFeedback * envelope[i];
+				}
+			}
+		}
+
+
+		//************ Damping and saturation of one sample on its way into the feedback line. The saturation is x / sqrt(1 + x^2), a ***//
+		//************ tanh-like curve whose magnitude never exceeds 1 (in float it rounds to exactly 1 from about |x| = 1e4 up). x is ******//
+		//************ first limited to +-65536, where the curve already gives exactly 1, so that x * x cannot overflow to infinity and ****//
+		//************ turn a huge sample into 0. No libm call: sqrt is a single instruction, correctly rounded on every ISA. ***************//
+
+		template <bool Deterministic>
+		float shapeFeedbackSample(float x, float& lowpass) const
+		{
+			if (feedbackDamping > 0)
+			{
+				if constexpr (Deterministic)
+					lowpass += DeterministicMath::fence((1.0f - feedbackDamping) * (x - lowpass));
+				else
+					lowpass += (1.0f - feedbackDamping) * (x - lowpass);
+
+				x = lowpass;
+			}
+
+			if (feedbackSaturation)
+			{
+				x = jlimit(-65536.0f, 65536.0f, x);
+
+				if constexpr (Deterministic)
+					x = x / std::sqrt(1.0f + DeterministicMath::fence(x * x));
+				else
+					x = x / std::sqrt(1.0f + x * x);
+			}
+
+			return x;
+		}
+
+
+		//************ Guards process() against calls that would write outside the buffers or overrun the delay ring **********************//
+
+		bool acceptBlock(AudioBuffer<float>* inbuffer, int startSample, int numSamples, int channel) const
+		{
+			const int numChannels = jmin(inbuffer->getNumChannels(), delayBuffer.getNumChannels());
+			const int maxBlockSize = delayBufferSize - transposition_range;
+
+			if (channel < 0 || channel >= numChannels)
+			{
+				if (diagnosticLog != nullptr)
+					diagnosticLog->log("Flanger", this, DiagnosticEvent::channelOutOfRange, channel, static_cast<float>(numChannels));
+				return false;
+			}
+
+			if (numSamples > maxBlockSize || startSample < 0 || startSample + numSamples > inbuffer->getNumSamples())
+			{
+				if (diagnosticLog != nullptr)
+					diagnosticLog->log("Flanger", this, DiagnosticEvent::blockTooLarge, channel, static_cast<float>(numSamples),
+									  static_cast<float>(jmin(maxBlockSize, inbuffer->getNumSamples() - jmax(0, startSample))));
+				return false;
+			}
+
+			if (modulationBus != nullptr && startSample + numSamples > modulationBus->getNumSamples() && diagnosticLog != nullptr)
+				diagnosticLog->log("Flanger", this, DiagnosticEvent::modulationBusNotRendered, channel, static_cast<float>(startSample + numSamples),
+								  static_cast<float>(modulationBus->getNumSamples()));
+
+			return true;
+		}
+
+		//************ One pass over the output: non-finite samples, or (with feedback) a peak far above any sane input level **************//
+
+		void checkOutput(AudioBuffer<float>* inbuffer, int startSample, int numSamples, int channel, float DeviceGain) const
+		{
+			if (diagnosticLog == nullptr)
+				return;
+
+			const float peak = DiagnosticLog::getPeakMagnitude(inbuffer->getReadPointer(channel, startSample), numSamples);
+
+			if (! std::isfinite(peak))
+				diagnosticLog->log("Flanger", this, DiagnosticEvent::nonFiniteOutput, channel, peak);
+			else if (feedbackLevel != 0 && peak > DIAGNOSTIC_RUNAWAY_LEVEL * std::abs(DeviceGain))
+				diagnosticLog->log("Flanger", this, DiagnosticEvent::feedbackRunaway, channel, peak / std::abs(DeviceGain), feedbackLevel);
+		}
+
+
+		//************ A linear piece of the LFO (sine + 1, scaled by the range afterwards) in deterministic mode: its start value and ****//
+		//************ slope, its length and how far into it the next sample is. ***********************************************************//
+
+		struct ControlSegment
+		{
+			float start{ 0.0f }, slope{ 0.0f };
+			int offset{ 0 }, length{ 1 };
+		};
+
+		void startControlSegment(ControlSegment& segment, float phase, float phaseIncrement) const
+		{
+			segment.length = getEffectiveControlRate();
+			segment.start = DeterministicMath::sine(phase) + 1.0f;
+
+			float endPhase = phase + DeterministicMath::fence(segment.length * phaseIncrement);
+			endPhase -= std::floor(endPhase);
+			segment.slope = (DeterministicMath::sine(endPhase) + 1.0f - segment.start) / segment.length;
+		}
+
+
+		//************ Layout of a saved state: this header, the LFO phases, the control segments, the damping filters, the sidechain ***//
+		//************ envelopes, then each channel's delay line region followed by each channel's feedback line region, oldest sample *//
+		//************ first. ************************************************************************************************************//
+
+		struct StateHeader
+		{
+			uint32_t magic, numChannels, liveLength;
+		};
+
+		static constexpr uint32_t stateMagic = 0x464c4734;		// "FLG4"
+
+		int getLiveLength() const
+		{
+			return transposition_range + 1;				// the modulation never reaches further back than the transposition range
+		}
+
+		char* copyFromRing(const float* ring, int writePosition, char* destination) const
+		{
+			const int liveLength = getLiveLength();
+			const int start = (writePosition - liveLength + delayBufferSize) % delayBufferSize;
+			const int firstPart = jmin(liveLength, delayBufferSize - start);
+
+			std::memcpy(destination, ring + start, sizeof(float) * firstPart);
+			std::memcpy(destination + sizeof(float) * firstPart, ring, sizeof(float) * (liveLength - firstPart));
+			return destination + sizeof(float) * liveLength;
+		}
+
+
+		int getEffectiveControlRate() const
+		{
+			static constexpr int tierControlRates[numQualityTiers] = { 1, 16, 64 };
+			return jmax(controlRate, tierControlRates[qualityTier]);
+		}
+
+
+		//************ Maps a position relative to the ring buffer start back into the ring. For fixed block sizes the position is known ***//
+		//************ to lie within one ring length of the buffer, so a compare replaces the integer division. ***************************//
+
+		template <int BlockSize>
+		static int ringIndex(int position, int ringSize)
+		{
+			if constexpr (BlockSize > 0)
+				return position < 0 ? position + ringSize : (position >= ringSize ? position - ringSize : position);
+			else
+				return (ringSize + position) % ringSize;
+		}
+
+		std::vector<float> sinePhase;
 		float sinefrequency{ 0.0 };
+		int controlRate{ 1 };
+		int qualityTier{ 0 };
+		bool deterministic{ false };
+		std::vector<ControlSegment> controlSegments;
+		DiagnosticLog* diagnosticLog{ nullptr };
+		bool metering{ false };
+		LevelMeter meter;
+		bool midSideComponents[2]{ false, true };
 
 		float flangerDepth{ 0.0 };
-		float feedbackLevel{ 0.0 };		    // should ALWAYS be lower than 1 !!
+		float feedbackLevel{ 0.0 };		    // should ALWAYS be lower than 1 !! (unless the feedback saturation is on)
+		float feedbackDamping{ 0.0f };
+		bool feedbackSaturation{ false };
+		std::vector<float> feedbackLowpass;	// per channel state of the damping filter
+		EnvelopeFollower sidechainFollower;
+		float sidechainDepth{ 0.0f }, sidechainRate{ 0.0f }, sidechainFeedback{ 0.0f };
+		const ModulationBus* modulationBus{ nullptr };
+		int busLFO{ 0 };
+		float busPhaseOffset{ 0.0f }, busScale{ 1.0f }, busSineWeight{ 1.0f }, busCosineWeight{ 0.0f };
 		
 
 		float sampleRate{ 44100 };
@@ -0,0 +1,219 @@
+/***************************************************************************************
+This class implements a one-time autotuner for the TileScheduler. It micro-benchmarks every
+tile size, with the runtime and the fixed block size kernels of the effects, on a copy of the
+chain and picks the fastest combination for this machine. The choice can be kept in a small
+cache file, keyed by CPU model and chain layout (channel count, effect types, block size), so
+later starts skip the benchmark.
+****************************************************************************************/
+
+#pragma once
+#include <JuceHeader.h>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <tuple>
+#include <typeinfo>
+#include "TileScheduler.h"
+
+#define DEFAULT_AUTOTUNE_BLOCKS 32         // blocks timed per candidate, the fastest one counts
+#define AUTOTUNE_WARMUP_BLOCKS 4
+#define AUTOTUNE_CACHE_FORMAT_VERSION 2    // bump whenever the key changes, so lines of older versions no longer match
+
+struct KernelChoice
+{
+	int tileSize{ 64 };
+	bool fixedTileKernels{ false };
+};
+
+
+class KernelAutotuner {
+
+	public :
+
+		//************ An empty path disables the cache file **************************************************************************//
+
+		KernelAutotuner(const std::string& cacheFilePath = std::string())
+			: cacheFilePath(cacheFilePath)
+		{
+
+		}
+
+
+		//************ Picks the fastest kernel for the chain and applies it to the scheduler. The effects must be initialized for ****//
+		//************ blockSize and numChannels; they are copied for the benchmark and left untouched. Not realtime safe. ***********//
+
+		template <typename... Effects>
+		KernelChoice tune(TileScheduler& scheduler, int blockSize, int numChannels, ChainStage<Effects>... stages)
+		{
+			const std::string key = std::to_string(AUTOTUNE_CACHE_FORMAT_VERSION) + "\t" + getCpuModel() + "\t" + std::to_string(numChannels) + "\t"
+								  + getChainLayout<Effects...>() + "\t" + std::to_string(blockSize);
+			KernelChoice best;
+
+			if (! loadChoice(key, best))
+			{
+				double bestTime = -1.0;
+
+				for (auto tile = MIN_TILE_SIZE; tile <= jmin(blockSize, MAX_TILE_SIZE); tile *= 2)
+				{
+					for (auto fixedKernels : { false, true })
+					{
+						const double time = measure(tile, fixedKernels, blockSize, numChannels, stages...);
+
+						if (bestTime < 0.0 || time < bestTime)
+						{
+							bestTime = time;
+							best = { tile, fixedKernels };
+						}
+					}
+				}
+
+				storeChoice(key, best);
+			}
+
+			scheduler.setTileSize(best.tileSize);
+			scheduler.setFixedTileKernels(best.fixedTileKernels);
+			return best;
+		}
+
+
+		static std::string getCpuModel()
+		{
+		   #if JUCE_LINUX
+			if (std::FILE* file = std::fopen("/proc/cpuinfo", "r"))
+			{
+				char line[256];
+
+				while (std::fgets(line, sizeof(line), file) != nullptr)
+				{
+					if (std::strncmp(line, "model name", 10) == 0)
+					{
+						std::string model(std::strchr(line, ':') != nullptr ? std::strchr(line, ':') + 2 : line);
+						std::fclose(file);
+						return model.substr(0, model.find('\n'));
+					}
+				}
+
+				std::fclose(file);
+			}
+		   #endif
+
+			return "unknown";
+		}
+
+
+
+	private :
+
+		//************ Runs copies of the effects over a noise block and returns the fastest of DEFAULT_AUTOTUNE_BLOCKS runs. The copies ***//
+		//************ leave a ModulationBus the originals subscribe to and run their own LFO: nobody renders the bus for them here. ******//
+
+		template <typename... Effects>
+		double measure(int tile, bool fixedKernels, int blockSize, int numChannels, ChainStage<Effects>... stages)
+		{
+			std::tuple<Effects...> effects(*stages.effect...);
+			std::apply([] (Effects&... copies) { (detachModulationBus(copies), ...); }, effects);
+
+			TileScheduler scheduler;
+			scheduler.setTileSize(tile);
+			scheduler.setFixedTileKernels(fixedKernels);
+
+			AudioBuffer<float> input(numChannels, blockSize), buffer(numChannels, blockSize);
+			std::minstd_rand random(1);
+			std::uniform_real_distribution<float> noise(-1.0f, 1.0f);
+
+			for (auto channel = 0; channel < numChannels; ++channel)
+				for (auto sample = 0; sample < blockSize; ++sample)
+					input.setSample(channel, sample, noise(random));
+
+			double fastest = -1.0;
+
+			for (auto run = 0; run < AUTOTUNE_WARMUP_BLOCKS + DEFAULT_AUTOTUNE_BLOCKS; ++run)
+			{
+				for (auto channel = 0; channel < numChannels; ++channel)
+					buffer.copyFrom(channel, 0, input, channel, 0, blockSize);
+
+				const auto start = std::chrono::steady_clock::now();
+
+				std::apply([&] (Effects&... copies)
+				{
+					scheduler.process(&buffer, 0, blockSize, ChainStage<Effects>{ &copies, stages.maxDelayInSamples, stages.gain }...);
+				}, effects);
+
+				const double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+				if (run >= AUTOTUNE_WARMUP_BLOCKS && (fastest < 0.0 || time < fastest))
+					fastest = time;
+			}
+
+			return fastest;
+		}
+
+		template <typename Effect>
+		static void detachModulationBus(Effect& effect)
+		{
+			if constexpr (HasModulationBus<Effect>::value)
+				effect.setModulationBus(nullptr);
+		}
+
+
+		//************ The effect types of the stages in order (compiler-specific type names), e.g. "7Flanger,12PitchShifter" ************//
+
+		template <typename... Effects>
+		static std::string getChainLayout()
+		{
+			std::string layout;
+			((layout += (layout.empty() ? "" : ",") + std::string(typeid(Effects).name())), ...);
+			return layout;
+		}
+
+
+		//************ Cache file: one "format <tab> cpu model <tab> channels <tab> stage types <tab> block size <tab> tile <tab> fixed" **//
+		//************ line per layout ****************************************************************************************************//
+
+		bool loadChoice(const std::string& key, KernelChoice& choice) const
+		{
+			if (cacheFilePath.empty())
+				return false;
+
+			std::FILE* file = std::fopen(cacheFilePath.c_str(), "r");
+
+			if (file == nullptr)
+				return false;
+
+			char line[1024];
+			bool found = false;
+
+			while (! found && std::fgets(line, sizeof(line), file) != nullptr)
+			{
+				int tile = 0, fixedKernels = 0;
+
+				if (std::strncmp(line, key.c_str(), key.size()) == 0 && line[key.size()] == '\t'
+					&& std::sscanf(line + key.size() + 1, "%d %d", &tile, &fixedKernels) == 2)
+				{
+					choice = { jlimit(MIN_TILE_SIZE, MAX_TILE_SIZE, tile), fixedKernels != 0 };
+					found = true;
+				}
+			}
+
+			std::fclose(file);
+			return found;
+		}
+
+		void storeChoice(const std::string& key, const KernelChoice& choice) const
+		{
+			if (cacheFilePath.empty())
+				return;
+
+			if (std::FILE* file = std::fopen(cacheFilePath.c_str(), "a"))
+			{
+				std::fprintf(file, "%s\t%d\t%d\n", key.c_str(), choice.tileSize, choice.fixedTileKernels ? 1 : 0);
+				std::fclose(file);
+			}
+		}
+
+
+		std::string cacheFilePath;
+
+};
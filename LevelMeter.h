@@ -0,0 +1,121 @@
+/***************************************************************************************
+This class publishes per-channel output levels (peak and RMS) of an effect instance. The audio
+thread hands it the peak and sum of squares it accumulated while writing a block; a UI or metrics
+thread reads the smoothed levels through atomics, without locking, as often as it likes.
+****************************************************************************************/
+
+#pragma once
+#include <JuceHeader.h>
+#include <atomic>
+#include <cmath>
+#include <memory>
+
+#define DEFAULT_METER_RELEASE_MS 300.0      // time for the peak and the RMS average to fall by 1/e once the signal stops
+
+class LevelMeter {
+
+	public :
+
+		LevelMeter()
+		{
+
+		}
+
+		LevelMeter(const LevelMeter& other)						// effects are copied, e.g. by KernelAutotuner
+		{
+			*this = other;
+		}
+
+		LevelMeter& operator= (const LevelMeter& other)
+		{
+			if (this != &other)
+			{
+				channels.reset(new Channel[jmax(0, other.numChannels)]);
+				numChannels = other.numChannels;
+				releasePerSample = other.releasePerSample;
+
+				for (auto channel = 0; channel < numChannels; ++channel)
+				{
+					channels[channel].heldPeak = other.channels[channel].heldPeak;
+					channels[channel].meanSquare = other.channels[channel].meanSquare;
+					channels[channel].peak.store(other.getPeak(channel), std::memory_order_relaxed);
+					channels[channel].rms.store(other.getRms(channel), std::memory_order_relaxed);
+				}
+			}
+
+			return *this;
+		}
+
+
+		//************ Allocates one meter per channel. Not realtime safe, call it from the effect's initialize(). ***********************//
+
+		void prepare(int numChannels, double SampleRate, double releaseMilliseconds = DEFAULT_METER_RELEASE_MS)
+		{
+			channels.reset(new Channel[jmax(0, numChannels)]);
+			this->numChannels = numChannels;
+			releasePerSample = static_cast<float>(-1000.0 / (releaseMilliseconds * SampleRate));
+		}
+
+		void reset()
+		{
+			for (auto channel = 0; channel < numChannels; ++channel)
+			{
+				channels[channel].heldPeak = channels[channel].meanSquare = 0.0f;
+				channels[channel].peak.store(0.0f, std::memory_order_relaxed);
+				channels[channel].rms.store(0.0f, std::memory_order_relaxed);
+			}
+		}
+
+
+		//************ Audio thread, once per block and channel: the peak magnitude and sum of squares of the numSamples samples written. **//
+		//************ The peak is held and released exponentially, the RMS is an exponential average of the mean square. Each channel ***//
+		//************ only touches its own meter, so channels may be processed on different threads. ***************************************//
+
+		void publish(int channel, float blockPeak, float sumOfSquares, int numSamples)
+		{
+			if (numSamples <= 0)
+				return;
+
+			Channel& meter = channels[channel];
+			const float decay = std::exp(releasePerSample * numSamples);
+
+			meter.heldPeak = jmax(blockPeak, meter.heldPeak * decay);
+			meter.meanSquare = decay * meter.meanSquare + (1.0f - decay) * (sumOfSquares / numSamples);
+
+			meter.peak.store(meter.heldPeak, std::memory_order_relaxed);
+			meter.rms.store(std::sqrt(meter.meanSquare), std::memory_order_relaxed);
+		}
+
+
+		//************ Any thread. Linear levels (1.0 = full scale); 0 for channels that do not exist. *************************************//
+
+		float getPeak(int channel) const
+		{
+			return channel >= 0 && channel < numChannels ? channels[channel].peak.load(std::memory_order_relaxed) : 0.0f;
+		}
+
+		float getRms(int channel) const
+		{
+			return channel >= 0 && channel < numChannels ? channels[channel].rms.load(std::memory_order_relaxed) : 0.0f;
+		}
+
+		int getNumChannels() const
+		{
+			return numChannels;
+		}
+
+
+
+	private :
+
+		struct alignas(64) Channel								// own cache line, channels may be processed on different threads
+		{
+			std::atomic<float> peak{ 0.0f }, rms{ 0.0f };		// published values
+			float heldPeak{ 0.0f }, meanSquare{ 0.0f };			// audio thread state
+		};
+
+		std::unique_ptr<Channel[]> channels;
+		int numChannels{ 0 };
+		float releasePerSample{ 0.0f };
+
+};
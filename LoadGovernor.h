@@ -0,0 +1,111 @@
+/***************************************************************************************
+This class implements a CPU load governor. It measures how much of each callback's time
+budget the processing takes and, when the load stays high, steps the registered effects down
+to cheaper quality tiers one instance at a time; when the load stays low again it steps them
+back up. Separate thresholds and hold times keep it from oscillating.
+****************************************************************************************/
+
+#pragma once
+#include <JuceHeader.h>
+#include <chrono>
+#include <functional>
+#include <vector>
+
+#define DEFAULT_LOAD_HIGH 0.75            // fraction of the callback budget above which quality is reduced
+#define DEFAULT_LOAD_LOW 0.45             // and below which it is restored
+#define DEFAULT_STEP_DOWN_CALLBACKS 4     // react quickly to overload...
+#define DEFAULT_STEP_UP_CALLBACKS 400     // ...but only recover after the load has been low for a while
+
+class LoadGovernor {
+
+	public :
+
+		LoadGovernor()
+		{
+
+		}
+
+
+		//************ Registers an effect (anything with setQualityTier and numQualityTiers). Not realtime safe, call before the ******//
+		//************ audio thread starts. The effect must outlive the governor. ******************************************************//
+
+		template <typename Effect>
+		void addInstance(Effect& effect)
+		{
+			instances.push_back([&effect] (int tier) { effect.setQualityTier(tier); });
+			maxTier = jmax(maxTier, Effect::numQualityTiers - 1);
+			effect.setQualityTier(0);
+		}
+
+		void setThresholds(double high, double low, int stepDownCallbacks = DEFAULT_STEP_DOWN_CALLBACKS, int stepUpCallbacks = DEFAULT_STEP_UP_CALLBACKS)
+		{
+			loadHigh = high;
+			loadLow = low;
+			stepDownHold = jmax(1, stepDownCallbacks);
+			stepUpHold = jmax(1, stepUpCallbacks);
+		}
+
+
+		//************ Audio thread: bracket the processing of every callback with these two calls. ***********************************//
+
+		void beginCallback()
+		{
+			callbackStart = std::chrono::steady_clock::now();
+		}
+
+		void endCallback(int numSamples, double sampleRate)
+		{
+			const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - callbackStart).count();
+			reportLoad(elapsed * sampleRate / numSamples);
+		}
+
+
+		//************ Feeds one load measurement (processing time / callback duration). The level counts how many instance steps *****//
+		//************ are taken: instance i runs at tier (level + i) / numInstances, so the cost goes down gradually. *****************//
+
+		void reportLoad(double load)
+		{
+			lastLoad = load;
+			highCount = load > loadHigh ? highCount + 1 : 0;
+			lowCount = load < loadLow ? lowCount + 1 : 0;
+
+			const int numInstances = static_cast<int>(instances.size());
+
+			if (highCount >= stepDownHold && level < maxTier * numInstances)
+				setLevel(level + 1);
+			else if (lowCount >= stepUpHold && level > 0)
+				setLevel(level - 1);
+		}
+
+		int getLevel() const			{ return level; }
+		double getLastLoad() const		{ return lastLoad; }
+
+
+
+	private :
+
+		void setLevel(int newLevel)
+		{
+			level = newLevel;
+			highCount = 0;
+			lowCount = 0;
+
+			const int numInstances = static_cast<int>(instances.size());
+
+			for (auto i = 0; i < numInstances; ++i)
+				instances[static_cast<size_t>(i)](jmin(maxTier, (level + i) / numInstances));
+		}
+
+
+		std::vector<std::function<void(int)>> instances;
+		int maxTier{ 0 };
+		int level{ 0 };
+
+		double loadHigh{ DEFAULT_LOAD_HIGH }, loadLow{ DEFAULT_LOAD_LOW };
+		int stepDownHold{ DEFAULT_STEP_DOWN_CALLBACKS }, stepUpHold{ DEFAULT_STEP_UP_CALLBACKS };
+		int highCount{ 0 }, lowCount{ 0 };
+		double lastLoad{ 0.0 };
+
+		std::chrono::steady_clock::time_point callbackStart;
+
+};
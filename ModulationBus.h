@@ -0,0 +1,202 @@
+/***************************************************************************************
+This class renders LFOs once per block into shared buffers, for sessions in which many effect
+instances sweep at the same rate. Each distinct LFO is rendered a single time as a sine / cosine
+pair; a subscribed instance derives its own phase offset and depth from the pair with two
+multiplies per sample (sin(a + b) = sin a cos b + cos a sin b), instead of evaluating a sine of
+its own. The cost then scales with the number of distinct LFOs, not with the number of instances.
+****************************************************************************************/
+
+#pragma once
+#include <JuceHeader.h>
+#include "DeterministicMath.h"
+#include <cmath>
+#include <vector>
+
+#define MAX_BUS_LFOS 32
+
+class ModulationBus {
+
+	public :
+
+		ModulationBus()
+		{
+			lfos.reserve(MAX_BUS_LFOS);
+		}
+
+
+		//************ Allocates the buffers for blocks of up to maxBlockSize samples. Not realtime safe. ******************************//
+
+		void prepare(int maxBlockSize, double SampleRate)
+		{
+			sampleRate = SampleRate;
+			maxSamples = jmax(0, maxBlockSize);
+
+			for (auto& lfo : lfos)
+			{
+				lfo.sine.assign(maxSamples, 0.0f);
+				lfo.cosine.assign(maxSamples, 1.0f);
+			}
+		}
+
+
+		//************ Returns the index of the LFO running at frequency (Hz), adding it if no LFO runs at that rate yet, or -1 when *****//
+		//************ all MAX_BUS_LFOS are taken. Instances asking for the same rate share one LFO. Not realtime safe. *****************//
+
+		int getLFO(float frequency)
+		{
+			for (size_t index = 0; index < lfos.size(); ++index)
+				if (lfos[index].frequency == frequency)
+					return static_cast<int>(index);
+
+			if (lfos.size() == MAX_BUS_LFOS)
+				return -1;
+
+			lfos.emplace_back();
+			lfos.back().frequency = frequency;
+			lfos.back().sine.assign(maxSamples, 0.0f);
+			lfos.back().cosine.assign(maxSamples, 1.0f);
+			return static_cast<int>(lfos.size() - 1);
+		}
+
+		//************ The accessors below take an index from getLFO(). An invalid one (e.g. getLFO()'s -1) is ignored by setFrequency(), ***//
+		//************ gives 0 Hz and null buffers; isValidLFO() tells in advance. ****************************************************************//
+
+		bool isValidLFO(int lfo) const
+		{
+			return lfo >= 0 && lfo < static_cast<int>(lfos.size());
+		}
+
+		void setFrequency(int lfo, float frequency)
+		{
+			jassert (isValidLFO(lfo));
+
+			if (isValidLFO(lfo))
+				lfos[lfo].frequency = frequency;
+		}
+
+		float getFrequency(int lfo) const
+		{
+			jassert (isValidLFO(lfo));
+			return isValidLFO(lfo) ? lfos[lfo].frequency : 0.0f;
+		}
+
+		int getNumLFOs() const
+		{
+			return static_cast<int>(lfos.size());
+		}
+
+
+		//************ Deterministic mode renders with the library-independent polynomial sine (see DeterministicMath), so the shared ***//
+		//************ buffers are bit-identical on every machine. Use it when the subscribers are deterministic. **************************//
+
+		void setDeterministic(bool shouldBeDeterministic)
+		{
+			deterministic = shouldBeDeterministic;
+		}
+
+		void reset()
+		{
+			for (auto& lfo : lfos)
+				lfo.phase = 0.0;
+
+			numSamples = 0;
+		}
+
+
+		//************ Audio thread, once per host block and before any subscriber processes it: renders numSamples samples of every **//
+		//************ LFO. Subscribers read them at the same positions as their buffer (startSample on), on any thread, until the ****//
+		//************ next render(); the owner must order render() before the subscribers' process() calls. *****************************//
+
+		void render(int blockLength)
+		{
+			numSamples = jlimit(0, maxSamples, blockLength);
+
+			for (auto& lfo : lfos)
+			{
+				const double increment = lfo.frequency / sampleRate;
+
+				if (deterministic)
+					renderDeterministic(lfo, static_cast<float>(increment));
+				else
+				{
+					renderRotation(lfo, increment);
+					lfo.phase += numSamples * increment;
+					lfo.phase -= std::floor(lfo.phase);
+				}
+			}
+		}
+
+		const float* getSine(int lfo) const
+		{
+			jassert (isValidLFO(lfo));
+			return isValidLFO(lfo) ? lfos[lfo].sine.data() : nullptr;
+		}
+
+		const float* getCosine(int lfo) const
+		{
+			jassert (isValidLFO(lfo));
+			return isValidLFO(lfo) ? lfos[lfo].cosine.data() : nullptr;
+		}
+
+		int getNumSamples() const
+		{
+			return numSamples;
+		}
+
+
+
+	private :
+
+		struct LFO
+		{
+			float frequency{ 0.0f };
+			double phase{ 0.0 };							// in cycles, of the first sample of the next block
+			std::vector<float> sine, cosine;
+		};
+
+		//************ Starts from the exact sine and cosine of the block's phase and rotates them by the phase increment every sample. *//
+		//************ In double precision the rotation stays accurate far beyond any block length, and it costs four multiplies *******//
+		//************ per sample instead of two sin() calls. ***********************************************************************************//
+
+		void renderRotation(LFO& lfo, double increment)
+		{
+			double sine = std::sin(2 * double_Pi * lfo.phase), cosine = std::cos(2 * double_Pi * lfo.phase);
+			const double stepSine = std::sin(2 * double_Pi * increment), stepCosine = std::cos(2 * double_Pi * increment);
+
+			for (auto sample = 0; sample < numSamples; ++sample)
+			{
+				lfo.sine[sample] = static_cast<float>(sine);
+				lfo.cosine[sample] = static_cast<float>(cosine);
+
+				const double nextSine = sine * stepCosine + cosine * stepSine;
+				cosine = cosine * stepCosine - sine * stepSine;
+				sine = nextSine;
+			}
+		}
+
+		void renderDeterministic(LFO& lfo, float increment)
+		{
+			float phase = static_cast<float>(lfo.phase);
+
+			for (auto sample = 0; sample < numSamples; ++sample)
+			{
+				float quarter = phase + 0.25f;
+				if (quarter >= 1) quarter -= 1;
+
+				lfo.sine[sample] = DeterministicMath::sine(phase);
+				lfo.cosine[sample] = DeterministicMath::sine(quarter);
+
+				phase = phase + increment;
+				if (phase >= 1) phase -= 1;
+			}
+
+			lfo.phase = phase;							// stepped in float, like the effects' own deterministic LFOs
+		}
+
+
+		std::vector<LFO> lfos;
+		double sampleRate{ 44100.0 };
+		int maxSamples{ 0 }, numSamples{ 0 };
+		bool deterministic{ false };
+
+};
@@ -0,0 +1,343 @@
+/***************************************************************************************
+This class implements a multiband flanger: the input is split into 2 to 4 bands by Linkwitz-Riley
+(4th order) crossovers, every band is flanged with its own depth and LFO rate, and the bands are
+summed again. The crossover filters of all bands run side by side in 4-lane arrays, which the
+compiler turns into one SIMD operation per filter step, and the band signals of a sample are
+stored as one interleaved frame, so the delay line takes a single write per sample for all bands.
+****************************************************************************************/
+
+#pragma once
+#include <JuceHeader.h>
+#include <cmath>
+#include <vector>
+#include "DelayRing.h"
+#include "DspTrace.h"
+
+#define MAX_FLANGER_BANDS 4
+#define MULTIBAND_TP_RANGE 0.010
+
+class MultibandFlanger {
+
+	public :
+
+		MultibandFlanger()
+		{
+			const float defaultCrossovers[MAX_FLANGER_BANDS - 1] = { 300.0f, 2000.0f, 8000.0f };
+
+			for (auto band = 0; band < MAX_FLANGER_BANDS; ++band)
+			{
+				bandDepth[band] = 0.0f;
+				bandRate[band] = 0.0f;
+			}
+
+			for (auto crossover = 0; crossover < MAX_FLANGER_BANDS - 1; ++crossover)
+				crossoverFrequency[crossover] = defaultCrossovers[crossover];
+		}
+
+
+		//************* Initialization of the band delay lines (one interleaved frame of MAX_FLANGER_BANDS samples per time step) and ****//
+		//************* of the crossover filters. ******************************************************************************************//
+
+		void initialize(int SamplesPerBlockExpected, double SampleRate, int numChannels = 2)
+		{
+			sampleRate = static_cast<float>(SampleRate);
+			transposition_range = MULTIBAND_TP_RANGE * SampleRate;
+			delayBufferSize = SamplesPerBlockExpected + transposition_range;
+
+			delayBuffer.setSize(numChannels, delayBufferSize * MAX_FLANGER_BANDS);
+			feedbackBuffer.setSize(numChannels, delayBufferSize * MAX_FLANGER_BANDS);
+			filterStates.resize(static_cast<size_t>(numChannels));
+
+			updateCrossovers();
+			reset();
+		}
+
+		void reset()
+		{
+			DelayRing::clear(delayBuffer);
+			DelayRing::clear(feedbackBuffer);
+			bandPhases.assign(static_cast<size_t>(delayBuffer.getNumChannels()) * MAX_FLANGER_BANDS, 0.0f);
+			std::fill(filterStates.begin(), filterStates.end(), ChannelFilterState());
+			delayBufferWritePosition = 0;
+		}
+
+
+		//************ DSP callback for a single channel, same contract as Flanger::process(): call it for every channel of the block, ***//
+		//************ then advance the write position with adjustWritePositions(). Per sample, the crossover splits the input into ******//
+		//************ the band lanes, the frame of band samples is written to the ring once, and each band reads its own two taps. ******//
+
+		void process(AudioBuffer<float>* inbuffer, int startSample, int numSamples, int maxDelayInSamples, int channel, float DeviceGain)
+		{
+			if (channel < 0 || channel >= jmin(inbuffer->getNumChannels(), delayBuffer.getNumChannels())
+				|| numSamples > delayBufferSize - transposition_range || startSample + numSamples > inbuffer->getNumSamples())
+			{
+				jassertfalse;			// same limits as Flanger::process()
+				return;
+			}
+
+			JUCE_FX_TRACE_SCOPE("MultibandFlanger process", channel);
+			ScopedNoDenormals noDenormals;			// the crossover filters' state decays into denormals in silence
+
+			float* writeBuffer = inbuffer->getWritePointer(channel, startSample);
+			float* delay = DelayRing::getWritePointer(delayBuffer, channel);
+			float* feedback = DelayRing::getWritePointer(feedbackBuffer, channel);
+			ChannelFilterState state = filterStates[static_cast<size_t>(channel)];		// a local copy cannot alias the buffers, which lets the lanes vectorize
+			const int numStages = numBands - 1;
+
+			float delayTimes[MAX_FLANGER_BANDS][modulationBlockSize];
+
+			for (auto blockStart = 0; blockStart < numSamples; blockStart += modulationBlockSize)
+			{
+				const int blockLength = jmin(modulationBlockSize, numSamples - blockStart);
+
+				for (auto band = 0; band < numBands; ++band)
+					renderBandDelayTimes(delayTimes[band], blockLength, maxDelayInSamples, channel, band);
+
+				for (auto i = 0; i < blockLength; ++i)
+				{
+					const int sample = blockStart + i;
+					const int frame = (delayBufferWritePosition + sample) % delayBufferSize;
+
+					alignas(16) float lanes[MAX_FLANGER_BANDS];
+
+					for (auto lane = 0; lane < MAX_FLANGER_BANDS; ++lane)
+						lanes[lane] = writeBuffer[sample];
+
+					for (auto stage = 0; stage < numStages; ++stage)
+						for (auto section = 0; section < 2; ++section)
+							crossovers[stage][section].process(lanes, state.sections[stage][section]);
+
+					float* delayFrame = delay + frame * MAX_FLANGER_BANDS;
+
+					for (auto lane = 0; lane < MAX_FLANGER_BANDS; ++lane)		// the single ring write for all bands
+						delayFrame[lane] = lanes[lane];
+
+					alignas(16) float bandOutputs[MAX_FLANGER_BANDS] = {};
+					float output = 0.0f;
+
+					for (auto band = 0; band < numBands; ++band)
+					{
+						float delayTime = delayTimes[band][i];
+						int delayTimeInSamples = static_cast<int>(delayTime);
+						float fractionalDelay = delayTime - delayTimeInSamples;
+
+						int readPosition1 = (delayBufferSize + delayBufferWritePosition + sample - delayTimeInSamples) % delayBufferSize;
+						int readPosition2 = (delayBufferSize + delayBufferWritePosition + sample - delayTimeInSamples - 1) % delayBufferSize;
+						int feedbackPosition1 = delayTimeInSamples > 0 ? readPosition1 : readPosition2;		// readPosition1 is the feedback sample not written yet
+
+						const float delayed = (1.0f - fractionalDelay) * delay[readPosition1 * MAX_FLANGER_BANDS + band] + fractionalDelay * delay[readPosition2 * MAX_FLANGER_BANDS + band];
+						const float fedBack = (1.0f - fractionalDelay) * feedback[feedbackPosition1 * MAX_FLANGER_BANDS + band] + fractionalDelay * feedback[readPosition2 * MAX_FLANGER_BANDS + band];
+
+						bandOutputs[band] = (feedbackLevel == 0 ? lanes[band] : 0.0f) + bandDepth[band] * delayed + feedbackLevel * fedBack;
+						output += bandOutputs[band];
+					}
+
+					float* feedbackFrame = feedback + frame * MAX_FLANGER_BANDS;
+
+					for (auto lane = 0; lane < MAX_FLANGER_BANDS; ++lane)
+						feedbackFrame[lane] = bandOutputs[lane];
+
+					writeBuffer[sample] = DeviceGain * output;
+				}
+			}
+
+			filterStates[static_cast<size_t>(channel)] = state;
+		}
+
+		void adjustWritePositions(int numsamplesInBuffer)
+		{
+			delayBufferWritePosition += numsamplesInBuffer;
+			delayBufferWritePosition %= delayBufferSize;
+		}
+
+
+		//**********  Setter member functions for GUI controlled owner of the multiband flanger object ***************************************//
+
+		void setNumBands(int bands)
+		{
+			numBands = jlimit(2, MAX_FLANGER_BANDS, bands);
+			updateCrossovers();
+		}
+
+		void setCrossoverFrequency(int crossover, float frequency)			// crossover i separates band i from band i + 1, keep them ascending
+		{
+			if (crossover >= 0 && crossover < MAX_FLANGER_BANDS - 1)
+			{
+				crossoverFrequency[crossover] = frequency;
+				updateCrossovers();
+			}
+		}
+
+		void setBandDepth(int band, float depth)
+		{
+			if (band >= 0 && band < MAX_FLANGER_BANDS)
+				bandDepth[band] = depth;
+		}
+
+		void setBandLFO(int band, float rate)
+		{
+			if (band >= 0 && band < MAX_FLANGER_BANDS)
+				bandRate[band] = rate;
+		}
+
+		void setFeedback(float feedback)
+		{
+			feedbackLevel = feedback;
+		}
+
+		void setControlRate(int samplesPerControlPoint)						// 1 = LFOs at audio rate, e.g. 16 or 32 for control rate
+		{
+			controlRate = jmax(1, samplesPerControlPoint);
+		}
+
+		int getNumBands() const
+		{
+			return numBands;
+		}
+
+
+
+	private :
+
+		static constexpr int modulationBlockSize = 256;
+
+
+		//************ One biquad section (transposed direct form II) per lane, with its own coefficients per lane. The lane loops have a **//
+		//************ fixed trip count of MAX_FLANGER_BANDS and no dependencies between lanes, so they vectorize. ***************************//
+
+		struct LaneSectionState
+		{
+			alignas(16) float s1[MAX_FLANGER_BANDS] = {};
+			alignas(16) float s2[MAX_FLANGER_BANDS] = {};
+		};
+
+		struct LaneSection
+		{
+			alignas(16) float b0[MAX_FLANGER_BANDS], b1[MAX_FLANGER_BANDS], b2[MAX_FLANGER_BANDS], a1[MAX_FLANGER_BANDS], a2[MAX_FLANGER_BANDS];
+
+			void process(float* lanes, LaneSectionState& state) const
+			{
+				alignas(16) float x[MAX_FLANGER_BANDS], y[MAX_FLANGER_BANDS];		// local copies, so the compiler knows nothing aliases
+
+				for (auto lane = 0; lane < MAX_FLANGER_BANDS; ++lane)
+					x[lane] = lanes[lane];
+
+				for (auto lane = 0; lane < MAX_FLANGER_BANDS; ++lane)
+				{
+					y[lane] = b0[lane] * x[lane] + state.s1[lane];
+					state.s1[lane] = b1[lane] * x[lane] - a1[lane] * y[lane] + state.s2[lane];
+					state.s2[lane] = b2[lane] * x[lane] - a2[lane] * y[lane];
+				}
+
+				for (auto lane = 0; lane < MAX_FLANGER_BANDS; ++lane)
+					lanes[lane] = y[lane];
+			}
+
+			void set(int lane, double c0, double c1, double c2, double d0, double d1, double d2)
+			{
+				b0[lane] = static_cast<float>(c0 / d0);
+				b1[lane] = static_cast<float>(c1 / d0);
+				b2[lane] = static_cast<float>(c2 / d0);
+				a1[lane] = static_cast<float>(d1 / d0);
+				a2[lane] = static_cast<float>(d2 / d0);
+			}
+		};
+
+		struct ChannelFilterState
+		{
+			LaneSectionState sections[MAX_FLANGER_BANDS - 1][2];
+		};
+
+
+		//************ Crossover i is applied to every lane as one stage of two Butterworth sections: lane i gets the low pass (a 4th ****//
+		//************ order Linkwitz-Riley low pass), the lanes above it the high pass, and the lanes below it, already split off, the *****//
+		//************ 2nd order allpass that equals LP + HP of this crossover, so that the bands stay in phase and sum to a flat response. *//
+
+		void updateCrossovers()
+		{
+			const double q = 1.0 / std::sqrt(2.0);
+
+			for (auto stage = 0; stage < MAX_FLANGER_BANDS - 1; ++stage)
+			{
+				const double w0 = 2.0 * double_Pi * jlimit(10.0, 0.45 * sampleRate, static_cast<double>(crossoverFrequency[stage])) / sampleRate;
+				const double cosw = std::cos(w0), alpha = std::sin(w0) / (2.0 * q);
+
+				for (auto lane = 0; lane < MAX_FLANGER_BANDS; ++lane)
+				{
+					for (auto section = 0; section < 2; ++section)
+					{
+						LaneSection& filter = crossovers[stage][section];
+
+						if (lane == stage)
+							filter.set(lane, (1.0 - cosw) / 2.0, 1.0 - cosw, (1.0 - cosw) / 2.0, 1.0 + alpha, -2.0 * cosw, 1.0 - alpha);
+						else if (lane > stage)
+							filter.set(lane, (1.0 + cosw) / 2.0, -(1.0 + cosw), (1.0 + cosw) / 2.0, 1.0 + alpha, -2.0 * cosw, 1.0 - alpha);
+						else if (section == 0)
+							filter.set(lane, 1.0 - alpha, -2.0 * cosw, 1.0 + alpha, 1.0 + alpha, -2.0 * cosw, 1.0 - alpha);
+						else
+							filter.set(lane, 1.0, 0.0, 0.0, 1.0, 0.0, 0.0);
+					}
+				}
+			}
+		}
+
+
+		//************ Same LFO as the Flanger's (see Flanger::renderDelayTimes), one phase per band and channel ***************************//
+
+		void renderBandDelayTimes(float* delayTimes, int numSamples, int maxDelayInSamples, int channel, int band)
+		{
+			float& phase = bandPhases[static_cast<size_t>(channel * MAX_FLANGER_BANDS + band)];
+			const float phaseIncrement = bandRate[band] / sampleRate;
+
+			if (controlRate == 1)
+			{
+				for (auto sample = 0; sample < numSamples; ++sample)
+				{
+					phase = phase + phaseIncrement;
+					if (phase >= 1) phase -= 1;
+					delayTimes[sample] = lfoValue(maxDelayInSamples, phase);
+				}
+				return;
+			}
+
+			for (auto segmentStart = 0; segmentStart < numSamples; segmentStart += controlRate)
+			{
+				const int segmentLength = jmin(controlRate, numSamples - segmentStart);
+
+				phase = phase + phaseIncrement;
+				if (phase >= 1) phase -= 1;
+				const float startValue = lfoValue(maxDelayInSamples, phase);
+
+				phase += (segmentLength - 1) * phaseIncrement;
+				phase -= std::floor(phase);
+
+				const float slope = (lfoValue(maxDelayInSamples, phase + phaseIncrement) - startValue) / segmentLength;
+
+				for (auto i = 0; i < segmentLength; ++i)
+					delayTimes[segmentStart + i] = startValue + slope * i;
+			}
+		}
+
+		static float lfoValue(int maxDelayInSamples, float phase)
+		{
+			return (maxDelayInSamples/2)*(sin(2 * double_Pi * phase)+1);
+		}
+
+
+		int numBands{ 2 };
+		float crossoverFrequency[MAX_FLANGER_BANDS - 1];
+		float bandDepth[MAX_FLANGER_BANDS], bandRate[MAX_FLANGER_BANDS];
+		float feedbackLevel{ 0.0 };		    // should ALWAYS be lower than 1 !!
+		int controlRate{ 1 };
+
+		LaneSection crossovers[MAX_FLANGER_BANDS - 1][2];
+		std::vector<ChannelFilterState> filterStates;
+		std::vector<float> bandPhases;
+
+		float sampleRate{ 44100 };
+		int delayBufferWritePosition{ 0 };
+		int transposition_range{ 0 };
+		int delayBufferSize{ 0 };
+		juce::AudioBuffer<float> delayBuffer, feedbackBuffer;
+
+};
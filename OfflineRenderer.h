@@ -0,0 +1,171 @@
+/***************************************************************************************
+This class implements an offline renderer that runs an effect chain over a whole file.
+Reading, processing and writing run on three threads connected by lock-free block queues,
+so disk I/O overlaps with the DSP instead of stalling it.
+****************************************************************************************/
+
+#pragma once
+#include <JuceHeader.h>
+#include <atomic>
+#include <thread>
+#include "SpscBlockQueue.h"
+#include "TileScheduler.h"
+
+#define DEFAULT_RENDER_BLOCK_SIZE 4096
+#define DEFAULT_RENDER_QUEUE_DEPTH 8
+
+class OfflineRenderer {
+
+	public :
+
+		OfflineRenderer(int blockSize = DEFAULT_RENDER_BLOCK_SIZE, int queueDepth = DEFAULT_RENDER_QUEUE_DEPTH)
+			: blockSize(blockSize), queueDepth(queueDepth)
+		{
+
+		}
+
+
+		//************ Renders every sample of the reader through the chain into the writer. The effects must already be initialized ***//
+		//************ with the reader's channel count and a block size of at least the renderer's block size. The reader thread ******//
+		//************ runs ahead by at most queueDepth blocks, and the DSP (on the calling thread) stalls when the writer falls *******//
+		//************ that far behind. Returns false if reading or writing failed, or without rendering if a stage is subscribed to a **//
+		//************ ModulationBus (see usesModulationBus()). ***********************************************************************//
+
+		template <typename... Effects>
+		bool render(AudioFormatReader& reader, AudioFormatWriter& writer, ChainStage<Effects>... stages)
+		{
+			if (usesModulationBus(stages...))
+				return false;
+
+			const int numChannels = static_cast<int>(reader.numChannels);
+
+			input.initialize(queueDepth, numChannels, blockSize);
+			output.initialize(queueDepth, numChannels, blockSize);
+			scheduler.initialize(numChannels, static_cast<int>(sizeof...(Effects)));
+			failed.store(false);
+
+			std::thread readerThread([&] { readBlocks(reader); });
+			std::thread writerThread([&] { writeBlocks(writer); });
+
+			processBlocks(numChannels, stages...);
+
+			readerThread.join();
+			writerThread.join();
+			return ! failed.load();
+		}
+
+
+
+	private :
+
+		void readBlocks(AudioFormatReader& reader)
+		{
+			const int64 length = reader.lengthInSamples;
+			int64 position = 0;
+			int attempt = 0;
+
+			while (position < length && ! failed.load(std::memory_order_relaxed))
+			{
+				AudioBuffer<float>* block = input.beginWrite();
+
+				if (block == nullptr)
+				{
+					SpscBlockQueue::wait(attempt);
+					continue;
+				}
+
+				attempt = 0;
+				const int numSamples = static_cast<int>(jmin(static_cast<int64>(blockSize), length - position));
+
+				if (! reader.read(block, 0, numSamples, position, true, true))
+				{
+					failed.store(true);
+					break;
+				}
+
+				input.endWrite(numSamples);
+				position += numSamples;
+			}
+
+			input.finish();
+		}
+
+
+		//************ The processed block goes into the writer's queue, so the reader can refill its block while the writer is busy. ***//
+
+		template <typename... Effects>
+		void processBlocks(int numChannels, ChainStage<Effects>... stages)
+		{
+			int attempt = 0;
+
+			while (! failed.load(std::memory_order_relaxed))
+			{
+				int numSamples = 0;
+				AudioBuffer<float>* source = input.beginRead(numSamples);
+
+				if (source == nullptr)
+				{
+					if (input.isDrained())
+						break;
+
+					SpscBlockQueue::wait(attempt);
+					continue;
+				}
+
+				AudioBuffer<float>* destination = output.beginWrite();
+
+				if (destination == nullptr)
+				{
+					SpscBlockQueue::wait(attempt);
+					continue;
+				}
+
+				attempt = 0;
+
+				for (auto channel = 0; channel < numChannels; ++channel)
+					destination->copyFrom(channel, 0, *source, channel, 0, numSamples);
+
+				input.endRead();
+
+				scheduler.process(destination, 0, numSamples, stages...);
+				output.endWrite(numSamples);
+			}
+
+			output.finish();
+		}
+
+
+		void writeBlocks(AudioFormatWriter& writer)
+		{
+			int attempt = 0;
+
+			while (! failed.load(std::memory_order_relaxed))
+			{
+				int numSamples = 0;
+				AudioBuffer<float>* block = output.beginRead(numSamples);
+
+				if (block == nullptr)
+				{
+					if (output.isDrained())
+						break;
+
+					SpscBlockQueue::wait(attempt);
+					continue;
+				}
+
+				attempt = 0;
+
+				if (! writer.writeFromAudioSampleBuffer(*block, 0, numSamples))
+					failed.store(true);
+
+				output.endRead();
+			}
+		}
+
+
+		int blockSize, queueDepth;
+		SpscBlockQueue input, output;
+		TileScheduler scheduler;
+		std::atomic<bool> failed{ false };
+
+};
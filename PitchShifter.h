@@ -4,6 +4,12 @@ This class implements a Doppler-effect based pitch shifting algorithm
 
 
 #include <JuceHeader.h>
+#include "DelayRing.h"
+#include "DeterministicMath.h"
+#include "DiagnosticLog.h"
+#include "DspTrace.h"
+#include "EnvelopeFollower.h"
+#include "LevelMeter.h"
 #define TP_RANGE 0.010           // specifies the transposition range in milliseconds (used for allocation of delay buffer)
 
 class PitchShifter {
@@ -15,15 +21,116 @@ public:
         // initialization happens in initialize()
     }
     
-    //************* Initialization of the delay buffer, hardcoded for 2 channels atm for demonstration purposes*******************//
-    //************* Regarding scalibiltiy, nr. of channels and buffer size should be provided as parameters under GUI control ***//
+    //************* Initialization of the delay buffer. The number of channels defaults to 2 (stereo), but any channel count ***********//
+    //************* can be requested, e.g. when the pitch shifter is scheduled by a TileScheduler over a multichannel buffer ***********//
 
-    void initialize(int SamplesPerBlockExpected, double SampleRate) {
+    void initialize(int SamplesPerBlockExpected, double SampleRate, int numChannels = 2) {
 
         transposition_range = TP_RANGE * SampleRate;
         delayBufferSize = SamplesPerBlockExpected + transposition_range;
-        delayBuffer.setSize(2, delayBufferSize);
-        delayBuffer.clear();
+        delayBuffer.setSize(numChannels, delayBufferSize);
+        DelayRing::clear(delayBuffer);
+
+        sawtoothPhase1.assign(numChannels, 0.0f);
+        sawtoothPhase2.assign(numChannels, 0.5f);
+        controlSegments.assign(numChannels, ControlSegment());
+        sidechainFollower.prepare(numChannels, SampleRate);
+        meter.prepare(numChannels, SampleRate);
+    }
+
+
+    //************* Clears the delay line and restarts the sawtooths, without reallocating. Use this to start an unrelated signal. ******//
+
+    void reset()
+    {
+        DelayRing::clear(delayBuffer);
+        std::fill(sawtoothPhase1.begin(), sawtoothPhase1.end(), 0.0f);
+        std::fill(sawtoothPhase2.begin(), sawtoothPhase2.end(), 0.5f);
+        std::fill(controlSegments.begin(), controlSegments.end(), ControlSegment());
+        sidechainFollower.reset();
+        meter.reset();
+        delayBufferWritePosition = 0;
+    }
+
+
+    //************* Snapshot of the running state: both sawtooth phases, the sidechain envelopes and, per channel, the part of the ***//
+    //************* delay line the modulation can still reach. Parameters are not included, the owner restores those. The blob does **//
+    //************* not depend on the block size passed to initialize(), so it can be restored into an instance on another machine ***//
+    //************* (same byte order), but the channel count and sample rate must match. saveState/restoreState never allocate, *****//
+    //************* saveState returns the number of bytes written (0 if the capacity is too small). *************************************//
+
+    size_t getStateSize() const
+    {
+        return sizeof(StateHeader) + (sizeof(float) * (3 + static_cast<size_t>(getLiveLength())) + sizeof(ControlSegment)) * sawtoothPhase1.size();
+    }
+
+    size_t saveState(void* destination, size_t capacity) const
+    {
+        if (capacity < getStateSize())
+            return 0;
+
+        const StateHeader header{ stateMagic, static_cast<uint32_t>(sawtoothPhase1.size()), static_cast<uint32_t>(getLiveLength()) };
+        char* bytes = static_cast<char*>(destination);
+
+        std::memcpy(bytes, &header, sizeof(header));
+        bytes += sizeof(header);
+        std::memcpy(bytes, sawtoothPhase1.data(), sizeof(float) * sawtoothPhase1.size());
+        bytes += sizeof(float) * sawtoothPhase1.size();
+        std::memcpy(bytes, sawtoothPhase2.data(), sizeof(float) * sawtoothPhase2.size());
+        bytes += sizeof(float) * sawtoothPhase2.size();
+        std::memcpy(bytes, controlSegments.data(), sizeof(ControlSegment) * controlSegments.size());
+        bytes += sizeof(ControlSegment) * controlSegments.size();
+        std::memcpy(bytes, sidechainFollower.getState().data(), sizeof(float) * sidechainFollower.getState().size());
+        bytes += sizeof(float) * sidechainFollower.getState().size();
+
+        for (size_t channel = 0; channel < sawtoothPhase1.size(); ++channel)
+        {
+            const float* ring = delayBuffer.getReadPointer(static_cast<int>(channel));
+            const int liveLength = getLiveLength();
+            const int start = (delayBufferWritePosition - liveLength + delayBufferSize) % delayBufferSize;
+            const int firstPart = jmin(liveLength, delayBufferSize - start);
+
+            std::memcpy(bytes, ring + start, sizeof(float) * firstPart);
+            std::memcpy(bytes + sizeof(float) * firstPart, ring, sizeof(float) * (liveLength - firstPart));
+            bytes += sizeof(float) * liveLength;
+        }
+
+        return getStateSize();
+    }
+
+    //************* The live region is put back at the start of the ring, and the write position right after it. Returns false (and **//
+    //************* leaves the state untouched) if the blob was saved by an instance with another configuration. **********************//
+
+    bool restoreState(const void* source, size_t size)
+    {
+        StateHeader header;
+
+        if (size != getStateSize())
+            return false;
+
+        const char* bytes = static_cast<const char*>(source);
+        std::memcpy(&header, bytes, sizeof(header));
+        bytes += sizeof(header);
+
+        if (header.magic != stateMagic || header.numChannels != sawtoothPhase1.size() || header.liveLength != static_cast<uint32_t>(getLiveLength()))
+            return false;
+
+        std::memcpy(sawtoothPhase1.data(), bytes, sizeof(float) * sawtoothPhase1.size());
+        bytes += sizeof(float) * sawtoothPhase1.size();
+        std::memcpy(sawtoothPhase2.data(), bytes, sizeof(float) * sawtoothPhase2.size());
+        bytes += sizeof(float) * sawtoothPhase2.size();
+        std::memcpy(controlSegments.data(), bytes, sizeof(ControlSegment) * controlSegments.size());
+        bytes += sizeof(ControlSegment) * controlSegments.size();
+        std::memcpy(sidechainFollower.getState().data(), bytes, sizeof(float) * sidechainFollower.getState().size());
+        bytes += sizeof(float) * sidechainFollower.getState().size();
+
+        const size_t regionBytes = sizeof(float) * header.liveLength;
+
+        for (size_t channel = 0; channel < sawtoothPhase1.size(); ++channel, bytes += regionBytes)
+            std::memcpy(delayBuffer.getWritePointer(static_cast<int>(channel)), bytes, regionBytes);
+
+        delayBufferWritePosition = getLiveLength() % delayBufferSize;
+        return true;
     }
 
 
@@ -33,37 +140,60 @@ public:
     //************ of the delay time. Each delay line has its separate sawtooth modulator and they are 180 out of phase. ********//
     //************ To eliminate glitches, we use sine envelopes for each delay line, and since they are 180 out of phase, *******//
     //************ output power is constant. *************************************************************************************//
+    //************ Only the numSamples samples from startSample on are processed, so a block may be split into several calls *****//
+    //************ as long as the write position is advanced by the length of each call. ****************************************//
 
     void process(AudioBuffer<float>* inbuffer, int startSample, int numSamples, int maxDelayInSamples, int channel, float deviceGain)						
     {
-        float* writeBuffer = inbuffer->getWritePointer(channel, startSample);
+        if (! acceptBlock(inbuffer, startSample, numSamples, channel))
+            return;
 
-        const int delayBufferSize = delayBuffer.getNumSamples();
-        fillDelaybuffer(inbuffer->getNumSamples(), channel, delayBufferSize, inbuffer->getReadPointer(channel, startSample), 1.0);
+        dispatchBlock<0>(inbuffer, startSample, numSamples, maxDelayInSamples, channel, deviceGain);
 
-        for (auto sample = 0; sample < numSamples; ++sample)
+        checkOutput(inbuffer, startSample, numSamples, channel);
+    }
 
-        {
+    //************ Same callback with the pitch driven at audio rate by an external source (an envelope follower, another oscillator, ***//
+    //************ ...) instead of stepping setLevel() per sub-block. modulation.pitchRatio holds one value per processed sample (index **//
+    //************ 0 = startSample), e.g. 1.5 for a fifth up or 0.5 for an octave down; each sets the signed speed of the sawtooths, so ***//
+    //************ the ratio may glide through 1 and change direction without a jump; setLevel() is then not used. sidechain is this ****//
+    //************ channel's sidechain signal, whose envelope moves the rate set with setSidechainModulation(). ***************************//
 
-            const float* delay = delayBuffer.getReadPointer(channel, startSample);
+    struct Modulation
+    {
+        const float* pitchRatio{ nullptr };
+        const float* sidechain{ nullptr };
+    };
+
+    void process(AudioBuffer<float>* inbuffer, int startSample, int numSamples, int maxDelayInSamples, int channel, float deviceGain, const Modulation& modulation)
+    {
+        if (modulation.pitchRatio == nullptr && modulation.sidechain == nullptr)
+            return process(inbuffer, startSample, numSamples, maxDelayInSamples, channel, deviceGain);
 
-            float delaySamples1 = sawtooth1(maxDelayInSamples, channel);
-            float delaySamples2 = sawtooth2(maxDelayInSamples, channel);
-            int delayTime1 = static_cast<int>(delaySamples1);
-            int delayTime2 = static_cast<int>(delaySamples2);
+        if (! acceptBlock(inbuffer, startSample, numSamples, channel))
+            return;
 
-            int readPosition1 = (delayBufferSize + delayBufferWritePosition - delayTime1) % delayBufferSize;
-            int readPosition2 = (delayBufferSize + delayBufferWritePosition - delayTime2) % delayBufferSize;
+        dispatchBlock<0, true>(inbuffer, startSample, numSamples, maxDelayInSamples, channel, deviceGain, &modulation);
 
+        checkOutput(inbuffer, startSample, numSamples, channel);
+    }
 
-            float gain1 = sin(double_Pi * delaySamples1 / maxDelayInSamples);
-            float gain2 = sin(double_Pi * delaySamples2 / maxDelayInSamples);
+    //************ Same callback for hosts that always deliver blocks of exactly BlockSize samples, e.g. process<256>(...). The trip ***//
+    //************ counts are then compile-time constants and the ring buffer indices wrap with a compare instead of a modulo. *********//
+    //************ BlockSize may not exceed the SamplesPerBlockExpected passed to initialize(). *****************************************//
 
+    template <int BlockSize>
+    void process(AudioBuffer<float>* inbuffer, int startSample, int maxDelayInSamples, int channel, float deviceGain)
+    {
+        static_assert (BlockSize > 0, "use the runtime overload for variable block sizes");
+        jassert (BlockSize + transposition_range <= delayBufferSize && maxDelayInSamples < transposition_range);
 
-            writeBuffer[sample] = deviceGain*(gain1 * (delay[(readPosition1 + sample) % delayBufferSize]) + gain2 * (delay[(readPosition2 + sample) % delayBufferSize]));
+        if (! acceptBlock(inbuffer, startSample, BlockSize, channel))
+            return;
 
-        }
+        dispatchBlock<BlockSize>(inbuffer, startSample, BlockSize, maxDelayInSamples, channel, deviceGain);
 
+        checkOutput(inbuffer, startSample, BlockSize, channel);
     }
 
     //******** This function copies each packet received at the callback into the circular delay buffer. This allows the algorithm***//
@@ -72,18 +202,9 @@ public:
 
     void fillDelaybuffer(const int bufferLength, int channel, const int delayBufferLength, const float* bufferData, const float gain)
     {
+        JUCE_FX_TRACE_SCOPE("PitchShifter fill delay line", channel);
 
-        if (delayBufferLength > bufferLength + delayBufferWritePosition)
-        {
-            delayBuffer.copyFromWithRamp(channel, delayBufferWritePosition, bufferData, bufferLength, gain, gain);
-        }
-        else
-        {
-            const int delayBufferRemaining = delayBufferLength - delayBufferWritePosition;
-            delayBuffer.copyFromWithRamp(channel, delayBufferWritePosition, bufferData, delayBufferRemaining, gain, gain);
-            delayBuffer.copyFromWithRamp(channel, 0, bufferData + delayBufferRemaining, bufferLength - delayBufferRemaining, gain, gain);
-
-        }
+        DelayRing::write(DelayRing::getWritePointer(delayBuffer, channel), delayBufferLength, delayBufferWritePosition, bufferData, bufferLength, gain);
 
     }
 
@@ -114,6 +235,195 @@ public:
     }
 
 
+    //********* Renders the delay times and sine envelopes of both delay lines for one modulation block. The sawtooths are cheap and ****//
+    //********* are stepped every sample, but the envelopes need a sin() per sample. At a control rate above 1 the envelopes are only ****//
+    //********* evaluated every 'controlRate' samples and linearly interpolated in between. Since sin(pi * phase) is 0 at both ends ******//
+    //********* of the sawtooth cycle, the interpolation stays continuous across the sawtooth reset. ************************************//
+
+    void renderModulation(float* delays1, float* delays2, float* gains1, float* gains2, int numSamples, int maxDelayInSamples, int channel)
+    {
+        JUCE_FX_TRACE_SCOPE("PitchShifter modulation", channel);
+        const int rate = getEffectiveControlRate();
+
+        if (rate == 1)
+        {
+            for (auto sample = 0; sample < numSamples; ++sample)
+            {
+                delays1[sample] = sawtooth1(maxDelayInSamples, channel);
+                delays2[sample] = sawtooth2(maxDelayInSamples, channel);
+                gains1[sample] = sin(double_Pi * delays1[sample] / maxDelayInSamples);
+                gains2[sample] = sin(double_Pi * delays2[sample] / maxDelayInSamples);
+            }
+            return;
+        }
+
+        const float phaseIncrement = sawtoothFrequency / sampleRate;
+
+        for (auto segmentStart = 0; segmentStart < numSamples; segmentStart += rate)
+        {
+            const int segmentLength = jmin(rate, numSamples - segmentStart);
+
+            for (auto i = segmentStart; i < segmentStart + segmentLength; ++i)
+            {
+                delays1[i] = sawtooth1(maxDelayInSamples, channel);
+                delays2[i] = sawtooth2(maxDelayInSamples, channel);
+            }
+
+            const float startGain1 = sin(double_Pi * delays1[segmentStart] / maxDelayInSamples);
+            const float startGain2 = sin(double_Pi * delays2[segmentStart] / maxDelayInSamples);
+            const float endPhase1 = sawtoothPhase1[channel] + phaseIncrement;
+            const float endPhase2 = sawtoothPhase2[channel] + phaseIncrement;
+            const float slope1 = (static_cast<float>(sin(double_Pi * (endPhase1 - std::floor(endPhase1)))) - startGain1) / segmentLength;
+            const float slope2 = (static_cast<float>(sin(double_Pi * (endPhase2 - std::floor(endPhase2)))) - startGain2) / segmentLength;
+
+            for (auto i = 0; i < segmentLength; ++i)
+            {
+                gains1[segmentStart + i] = startGain1 + slope1 * i;
+                gains2[segmentStart + i] = startGain2 + slope2 * i;
+            }
+        }
+    }
+
+
+    //********* Deterministic version of renderModulation (see setDeterministic). The envelope control points sit at fixed positions ***//
+    //********* of the stream (every 'controlRate' samples from the start) instead of restarting with every call, so the output does ****//
+    //********* not depend on how the stream is split into blocks or tiles, and the sine is the library-independent polynomial. *********//
+
+    void renderModulationDeterministic(float* delays1, float* delays2, float* gains1, float* gains2, int numSamples, int maxDelayInSamples, int channel)
+    {
+        JUCE_FX_TRACE_SCOPE("PitchShifter modulation", channel);
+        ControlSegment& segment = controlSegments[channel];
+
+        for (auto sample = 0; sample < numSamples; ++sample)
+        {
+            delays1[sample] = sawtooth1(maxDelayInSamples, channel);
+            delays2[sample] = sawtooth2(maxDelayInSamples, channel);
+
+            if (segment.offset == 0)
+                startControlSegment(segment, sawtoothPhase1[channel], sawtoothPhase2[channel]);
+
+            gains1[sample] = segment.start1 + DeterministicMath::fence(segment.slope1 * segment.offset);
+            gains2[sample] = segment.start2 + DeterministicMath::fence(segment.slope2 * segment.offset);
+
+            if (++segment.offset == segment.length)
+                segment.offset = 0;
+        }
+    }
+
+
+    //********* Modulation block for process() with a pitch ratio or sidechain buffer. The delay of a line moving at d samples per ****//
+    //********* sample shifts the pitch by 1 - d, so each ratio becomes a signed phase increment for both sawtooths; without ratios ****//
+    //********* the set rate is used. The sidechain envelope adds to that speed. Increments are limited to half a cycle per sample, ****//
+    //********* which also keeps a NaN from reaching the read positions. The delays follow the same up/down mapping as sawtooth1/2(), **//
+    //********* so switching between the process() variants does not jump. The envelopes run at audio rate. *************************//
+
+    template <bool Deterministic>
+    void renderDrivenModulation(float* delays1, float* delays2, float* gains1, float* gains2, int numSamples, int maxDelayInSamples, int channel, const Modulation& modulation, int blockStart)
+    {
+        JUCE_FX_TRACE_SCOPE("PitchShifter modulation", channel);
+        float increments[modulationBlockSize];
+
+        if (modulation.pitchRatio != nullptr)
+        {
+            const float incrementPerRatio = (pitchUporDown ? 1.0f : -1.0f) / maxDelayInSamples;
+
+            for (auto sample = 0; sample < numSamples; ++sample)
+                increments[sample] = (modulation.pitchRatio[blockStart + sample] - 1.0f) * incrementPerRatio;
+        }
+        else
+            std::fill(increments, increments + numSamples, sawtoothFrequency / sampleRate);
+
+        if (modulation.sidechain != nullptr)
+        {
+            float envelope[modulationBlockSize];
+            sidechainFollower.process<Deterministic>(channel, modulation.sidechain + blockStart, envelope, numSamples);
+            const float incrementPerEnvelope = sidechainRate / sampleRate;
+
+            for (auto sample = 0; sample < numSamples; ++sample)
+            {
+                if constexpr (Deterministic)
+                    increments[sample] = DeterministicMath::fence(increments[sample]) + DeterministicMath::fence(incrementPerEnvelope * envelope[sample]);
+                else
+                    increments[sample] += incrementPerEnvelope * envelope[sample];
+            }
+        }
+
+        float phase1 = sawtoothPhase1[channel], phase2 = sawtoothPhase2[channel];
+
+        for (auto sample = 0; sample < numSamples; ++sample)
+        {
+            float increment = increments[sample];
+
+            if constexpr (Deterministic)
+                increment = DeterministicMath::fence(increment);
+
+            if (! (std::abs(increment) < 0.5f))                     // also true for NaN, which stops the sawtooths
+                increment = increment > 0.0f ? 0.5f : (increment < 0.0f ? -0.5f : 0.0f);
+            phase1 += increment;
+            phase2 += increment;
+            phase1 -= std::floor(phase1);
+            phase2 -= std::floor(phase2);
+
+            delays1[sample] = maxDelayInSamples * (pitchUporDown ? 1 - phase1 : phase1);
+            delays2[sample] = maxDelayInSamples * (pitchUporDown ? 1 - phase2 : phase2);
+
+            if constexpr (Deterministic)
+            {
+                gains1[sample] = DeterministicMath::sine(0.5f * phase1);
+                gains2[sample] = DeterministicMath::sine(0.5f * phase2);
+            }
+            else
+            {
+                gains1[sample] = sin(double_Pi * phase1);
+                gains2[sample] = sin(double_Pi * phase2);
+            }
+        }
+
+        sawtoothPhase1[channel] = phase1;
+        sawtoothPhase2[channel] = phase2;
+        controlSegments[channel].offset = 0;                        // the sawtooths moved on their own, restart the envelope segment there
+    }
+
+
+    //********* Moves both sawtooths to where they would be after samplePosition samples from the start, so a render can begin in the **//
+    //********* middle of a file (e.g. one segment of a split render) and line up with the other segments. The phases are stepped ******//
+    //********* exactly like sawtooth1/2() do, so they match a continuous render bit for bit; this only costs an add per sample. *******//
+
+    void setModulatorPosition(int64 samplePosition)
+    {
+        float phase1 = 0.0f, phase2 = 0.5f;
+        ControlSegment segment;
+        const int rate = getEffectiveControlRate();
+        const int64 segmentStart = samplePosition - samplePosition % rate;      // in deterministic mode, the control segment we seek into
+
+        for (int64 sample = 0; sample < samplePosition; ++sample)
+        {
+            float samplespercycle = sampleRate / sawtoothFrequency;
+            phase1 += (1 / samplespercycle);
+            if (phase1 >= 1) phase1 -= 1;
+            phase2 += (1 / samplespercycle);
+            if (phase2 >= 1) phase2 -= 1;
+
+            if (sample == segmentStart && deterministic)
+                startControlSegment(segment, phase1, phase2);
+        }
+
+        segment.offset = static_cast<int>(samplePosition - segmentStart);
+        std::fill(sawtoothPhase1.begin(), sawtoothPhase1.end(), phase1);
+        std::fill(sawtoothPhase2.begin(), sawtoothPhase2.end(), phase2);
+        std::fill(controlSegments.begin(), controlSegments.end(), segment);
+    }
+
+
+    //********* Samples the pitch shifter keeps ringing after its input stops: one delay line length, as it has no feedback. Used as ***//
+    //********* the pre-roll of split renders (see RenderFarm). *************************************************************************//
+
+    int64 getTailSamples() const
+    {
+        return getLiveLength();
+    }
+
+
     //************ To update the write index of the circular buffer after storing a packet in the callback. We don't do this in the fillDelayBuffer ** //
     //************ as we can only adjust it after each channel has been copied. Hence, it has to be called by the owning class after the channel loop *//
     //************ has completed **********************************************************************************************************************//
@@ -126,29 +436,328 @@ public:
 
 
 
+    //************ Same as above, under the name shared with the flanger so owners can treat every effect alike (see TileScheduler). ***//
+
+    void adjustWritePositions(int numsamplesInBuffer)
+    {
+        adjustDelayBufferWritePosition(numsamplesInBuffer);
+    }
+
+
+
     //**********  Setter member functions for GUI controlled owner of the pitch shifting object ***********************************************//
 
 
     void setUp()
     {
+        JUCE_FX_TRACE_PARAMETER("PitchShifter up", pitchUporDown, true);
         pitchUporDown = true;
     }
 
     void setDown()
     {
+        JUCE_FX_TRACE_PARAMETER("PitchShifter up", pitchUporDown, false);
         pitchUporDown = false;
     }
 
     void setLevel(float rate)
     {
+        JUCE_FX_TRACE_PARAMETER("PitchShifter rate", sawtoothFrequency, rate);
         sawtoothFrequency = rate;
     }
 
+    //********* Rates accepted by setLevel() are 0 <= rate < getMaxLevel(): the sawtooths may not step backwards, nor by half a cycle or **//
+    //********* more per sample, or the delay times leave the delay line. Callers taking the rate from outside must check it. **************//
+
+    float getMaxLevel() const
+    {
+        return sampleRate / 2;
+    }
+
+    //********* Sidechain modulation (see Modulation::sidechain): the envelope of the sidechain (about 0 to 1 for a full scale signal) ***//
+    //********* times rateAmount is added, sample by sample, to the sawtooth rate in Hz, i.e. to the amount of transposition. A rate ******//
+    //********* pushed below 0 reverses the direction of the shift. The pitch shifter has no depth or feedback to modulate. **************//
+
+    void setSidechainModulation(float rateAmount)
+    {
+        sidechainRate = rateAmount;
+    }
+
+    void setSidechainFollower(double attackMilliseconds, double releaseMilliseconds)
+    {
+        sidechainFollower.setAttack(attackMilliseconds);
+        sidechainFollower.setRelease(releaseMilliseconds);
+    }
+
+    void setControlRate(int samplesPerControlPoint)                 // 1 = envelopes at audio rate, e.g. 16 or 32 for control rate
+    {
+        JUCE_FX_TRACE_PARAMETER("PitchShifter control rate", controlRate, jmax(1, samplesPerControlPoint));
+        controlRate = jmax(1, samplesPerControlPoint);
+    }
+
+    //********* Quality tiers for overload handling (see LoadGovernor). Tier 0 runs as configured, higher tiers evaluate the sine ******//
+    //********* envelopes at a coarser control rate. The sawtooths stay exact, so the tier may change between any two blocks. *********//
+
+    static constexpr int numQualityTiers = 3;
+
+    void setQualityTier(int tier)
+    {
+        JUCE_FX_TRACE_PARAMETER("PitchShifter quality tier", qualityTier, jlimit(0, numQualityTiers - 1, tier));
+        qualityTier = jlimit(0, numQualityTiers - 1, tier);
+    }
+
+    int getQualityTier() const
+    {
+        return qualityTier;
+    }
+
+    //********* Deterministic mode: the output is bit-identical whatever the compiler flags, instruction set (SSE, AVX, FMA), C *********//
+    //********* library, block size or tiling, for audits and render caches. It uses a polynomial sine instead of sin(), rounds *********//
+    //********* every product on its own (no FMA contraction) and anchors the envelope control points to the stream (see ****************//
+    //********* renderModulationDeterministic). Its output differs slightly from the default mode. Set it before processing starts. ******//
+
+    void setDeterministic(bool shouldBeDeterministic)
+    {
+        deterministic = shouldBeDeterministic;
+    }
+
+    //********* Reports anomalies found in process() to the log (nullptr to stop). Blocks larger than the configured size and *********//
+    //********* invalid channel indices are always skipped, with or without a log; the output check only runs with one. ****************//
+
+    void setDiagnosticLog(DiagnosticLog* log)
+    {
+        diagnosticLog = log;
+    }
+
+    //********* Output metering: with it on, the sample loop also tracks each channel's peak and RMS, and publishes them once per *****//
+    //********* block. getOutputMeter().getPeak(channel) / getRms(channel) may then be read from any thread. ****************************//
+
+    void setMetering(bool shouldMeter)
+    {
+        metering = shouldMeter;
+    }
+
+    const LevelMeter& getOutputMeter() const
+    {
+        return meter;
+    }
+
+    //********* Feeds every setting that shapes the output into a hasher (see RenderCache), so renders can be identified by content ****//
+
+    template <typename Hasher>
+    void hashSettings(Hasher& hasher) const
+    {
+        hasher.add("PitchShifter");
+        hasher.add(transposition_range);                            // the only part of the initialize() configuration that reaches the output
+        hasher.add(sawtoothFrequency);
+        hasher.add(pitchUporDown);
+        hasher.add(getEffectiveControlRate());
+        hasher.add(deterministic);
+        hasher.add(sidechainRate);
+        hasher.add(sidechainFollower.getAttack());
+        hasher.add(sidechainFollower.getRelease());
+    }
+
  
 private:
+
+    static constexpr int modulationBlockSize = 256;                 // the modulators are rendered in blocks of at most this many samples
+
+
+    //************ Picks the kernel variant for the current modes, so the per-sample loop carries no runtime mode checks ****************//
+
+    template <int BlockSize, bool Modulated = false>
+    void dispatchBlock(AudioBuffer<float>* inbuffer, int startSample, int numSamples, int maxDelayInSamples, int channel, float deviceGain, const Modulation* modulation = nullptr)
+    {
+        if (deterministic)
+        {
+            if (metering)
+                processBlock<BlockSize, true, true, Modulated>(inbuffer, startSample, numSamples, maxDelayInSamples, channel, deviceGain, modulation);
+            else
+                processBlock<BlockSize, true, false, Modulated>(inbuffer, startSample, numSamples, maxDelayInSamples, channel, deviceGain, modulation);
+        }
+        else
+        {
+            if (metering)
+                processBlock<BlockSize, false, true, Modulated>(inbuffer, startSample, numSamples, maxDelayInSamples, channel, deviceGain, modulation);
+            else
+                processBlock<BlockSize, false, false, Modulated>(inbuffer, startSample, numSamples, maxDelayInSamples, channel, deviceGain, modulation);
+        }
+    }
+
+
+    //************ The actual pitch shifting kernel. BlockSize 0 means the block size is only known at runtime (numSamples). **********//
+
+    template <int BlockSize, bool Deterministic, bool Metering, bool Modulated>
+    void processBlock(AudioBuffer<float>* inbuffer, int startSample, int numSamples, int maxDelayInSamples, int channel, float deviceGain, const Modulation* modulation)
+    {
+        if constexpr (BlockSize > 0)
+            numSamples = BlockSize;
+
+        JUCE_FX_TRACE_SCOPE("PitchShifter process", channel);
+
+        float* writeBuffer = inbuffer->getWritePointer(channel, startSample);
+
+        const int delayBufferSize = delayBuffer.getNumSamples();
+        fillDelaybuffer(numSamples, channel, delayBufferSize, inbuffer->getReadPointer(channel, startSample), 1.0);
+
+        const float* delay = delayBuffer.getReadPointer(channel);
+        float delays1[modulationBlockSize], delays2[modulationBlockSize];
+        float gains1[modulationBlockSize], gains2[modulationBlockSize];
+        float peak = 0.0f, sumOfSquares = 0.0f;
+
+        for (auto blockStart = 0; blockStart < numSamples; blockStart += modulationBlockSize)
+        {
+            const int blockLength = jmin(modulationBlockSize, numSamples - blockStart);
+            if constexpr (Modulated)
+                renderDrivenModulation<Deterministic>(delays1, delays2, gains1, gains2, blockLength, maxDelayInSamples, channel, *modulation, blockStart);
+            else if constexpr (Deterministic)
+                renderModulationDeterministic(delays1, delays2, gains1, gains2, blockLength, maxDelayInSamples, channel);
+            else
+                renderModulation(delays1, delays2, gains1, gains2, blockLength, maxDelayInSamples, channel);
+
+            JUCE_FX_TRACE_SCOPE("PitchShifter taps and mix", channel);
+
+            for (auto i = 0; i < blockLength; ++i)
+            {
+                const int sample = blockStart + i;
+
+                int delayTime1 = static_cast<int>(delays1[i]);
+                int delayTime2 = static_cast<int>(delays2[i]);
+
+                int readPosition1 = ringIndex<BlockSize>(delayBufferWritePosition + sample - delayTime1, delayBufferSize);
+                int readPosition2 = ringIndex<BlockSize>(delayBufferWritePosition + sample - delayTime2, delayBufferSize);
+
+                if constexpr (Deterministic)
+                    writeBuffer[sample] = deviceGain*(DeterministicMath::fence(gains1[i] * delay[readPosition1]) + DeterministicMath::fence(gains2[i] * delay[readPosition2]));
+                else
+                    writeBuffer[sample] = deviceGain*(gains1[i] * delay[readPosition1] + gains2[i] * delay[readPosition2]);
+
+                if constexpr (Metering)
+                {
+                    peak = jmax(peak, std::abs(writeBuffer[sample]));
+                    sumOfSquares += writeBuffer[sample] * writeBuffer[sample];
+                }
+            }
+        }
+
+        if constexpr (Metering)
+            meter.publish(channel, peak, sumOfSquares, numSamples);
+    }
+
+
+    //************ Guards process() against calls that would write outside the buffers or overrun the delay ring **********************//
+
+    bool acceptBlock(AudioBuffer<float>* inbuffer, int startSample, int numSamples, int channel) const
+    {
+        const int numChannels = jmin(inbuffer->getNumChannels(), delayBuffer.getNumChannels());
+        const int maxBlockSize = delayBufferSize - transposition_range;
+
+        if (channel < 0 || channel >= numChannels)
+        {
+            if (diagnosticLog != nullptr)
+                diagnosticLog->log("PitchShifter", this, DiagnosticEvent::channelOutOfRange, channel, static_cast<float>(numChannels));
+            return false;
+        }
+
+        if (numSamples > maxBlockSize || startSample < 0 || startSample + numSamples > inbuffer->getNumSamples())
+        {
+            if (diagnosticLog != nullptr)
+                diagnosticLog->log("PitchShifter", this, DiagnosticEvent::blockTooLarge, channel, static_cast<float>(numSamples),
+                                      static_cast<float>(jmin(maxBlockSize, inbuffer->getNumSamples() - jmax(0, startSample))));
+            return false;
+        }
+
+        return true;
+    }
+
+    //************ One pass over the output for non-finite samples (there is no feedback path that could run away) *********************//
+
+    void checkOutput(AudioBuffer<float>* inbuffer, int startSample, int numSamples, int channel) const
+    {
+        if (diagnosticLog == nullptr)
+            return;
+
+        const float peak = DiagnosticLog::getPeakMagnitude(inbuffer->getReadPointer(channel, startSample), numSamples);
+
+        if (! std::isfinite(peak))
+            diagnosticLog->log("PitchShifter", this, DiagnosticEvent::nonFiniteOutput, channel, peak);
+    }
+
+
+    //************ A linear piece of both sine envelopes in deterministic mode: start values and slopes, its length and how far into **//
+    //************ it the next sample is. ***********************************************************************************************//
+
+    struct ControlSegment
+    {
+        float start1{ 0.0f }, slope1{ 0.0f }, start2{ 0.0f }, slope2{ 0.0f };
+        int offset{ 0 }, length{ 1 };
+    };
+
+    void startControlSegment(ControlSegment& segment, float phase1, float phase2) const
+    {
+        const float phaseIncrement = 1 / (sampleRate / sawtoothFrequency);
+        segment.length = getEffectiveControlRate();
+        segment.start1 = DeterministicMath::sine(0.5f * phase1);            // sin(pi * phase), whether the sawtooth runs up or down
+        segment.start2 = DeterministicMath::sine(0.5f * phase2);
+
+        float endPhase1 = phase1 + DeterministicMath::fence(segment.length * phaseIncrement);
+        float endPhase2 = phase2 + DeterministicMath::fence(segment.length * phaseIncrement);
+        endPhase1 -= std::floor(endPhase1);
+        endPhase2 -= std::floor(endPhase2);
+
+        segment.slope1 = (DeterministicMath::sine(0.5f * endPhase1) - segment.start1) / segment.length;
+        segment.slope2 = (DeterministicMath::sine(0.5f * endPhase2) - segment.start2) / segment.length;
+    }
+
+
+    //************ Layout of a saved state: this header, the phases of sawtooth 1, those of sawtooth 2, the control segments, the *****//
+    //************ sidechain envelopes, then each channel's delay line region, oldest sample first. **************************************//
+
+    struct StateHeader
+    {
+        uint32_t magic, numChannels, liveLength;
+    };
+
+    static constexpr uint32_t stateMagic = 0x50534833;             // "PSH3"
+
+    int getLiveLength() const
+    {
+        return transposition_range + 1;                            // the sawtooths never reach further back than the transposition range
+    }
+
+
+    int getEffectiveControlRate() const
+    {
+        static constexpr int tierControlRates[numQualityTiers] = { 1, 16, 64 };
+        return jmax(controlRate, tierControlRates[qualityTier]);
+    }
+
+
+    //************ Maps a position relative to the ring buffer start back into the ring. For fixed block sizes the position is known ***//
+    //************ to lie within one ring length of the buffer, so a compare replaces the integer division. ***************************//
+
+    template <int BlockSize>
+    static int ringIndex(int position, int ringSize)
+    {
+        if constexpr (BlockSize > 0)
+            return position < 0 ? position + ringSize : (position >= ringSize ? position - ringSize : position);
+        else
+            return (ringSize + position) % ringSize;
+    }
+
     
-    float sawtoothPhase1[2]{ 0,0 }, sawtoothPhase2[2]{ 0.5,0.5 };  // sawtooth functions shifted by pi/2 with respect to each other
+    std::vector<float> sawtoothPhase1, sawtoothPhase2;             // sawtooth functions shifted by pi/2 with respect to each other (set in initialize)
     float sawtoothFrequency{0.0 };
+    int controlRate{ 1 };
+    int qualityTier{ 0 };
+    bool deterministic{ false };
+    std::vector<ControlSegment> controlSegments;
+    DiagnosticLog* diagnosticLog{ nullptr };
+    bool metering{ false };
+    LevelMeter meter;
+    EnvelopeFollower sidechainFollower;
+    float sidechainRate{ 0.0f };
 
     float sampleRate{ 44100 };
     int delayBufferWritePosition{ 0 };
@@ -0,0 +1,453 @@
+/***************************************************************************************
+This class implements an on-disk, content-addressed cache of offline renders (POSIX only).
+A render is identified by a hash of the input audio, the effect types and their settings and
+the library version; its output is stored as raw planar floats that can be memory-mapped.
+Repeated requests are served from the cache without running the DSP.
+****************************************************************************************/
+
+#pragma once
+#include <JuceHeader.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "TileScheduler.h"
+#include "Version.h"
+
+#define DEFAULT_CACHE_BLOCK_SIZE 4096
+#define MAX_CACHE_CHANNELS 32
+#define RENDER_CACHE_FORMAT_VERSION 3          // bump whenever the file layout, or the output of an unchanged setting, changes
+
+
+//************ 128 bit hash (two independent 64 bit lanes), good enough to tell renders apart; not meant to resist attacks ***********//
+
+class RenderHash {
+
+	public :
+
+		void add(const void* data, size_t size)
+		{
+			const auto* bytes = static_cast<const unsigned char*>(data);
+			length += size;
+
+			while (size > 0)
+			{
+				const size_t chunk = jmin(size, sizeof(uint64_t) - pendingBytes);
+				std::memcpy(reinterpret_cast<unsigned char*>(&pending) + pendingBytes, bytes, chunk);
+				pendingBytes += chunk;
+				bytes += chunk;
+				size -= chunk;
+
+				if (pendingBytes == sizeof(uint64_t))
+				{
+					mixWord(pending);
+					pending = 0;
+					pendingBytes = 0;
+				}
+			}
+		}
+
+		void add(const char* text)
+		{
+			add(text, std::strlen(text) + 1);
+		}
+
+		template <typename Value>
+		void add(Value value)
+		{
+			static_assert (std::is_arithmetic<Value>::value, "only plain numbers can be hashed by value");
+			add(&value, sizeof(value));
+		}
+
+
+		//************ 32 hex digits, used as the cache file name **************************************************************************//
+
+		std::string toString() const
+		{
+			uint64_t first = lanes[0], second = lanes[1];
+
+			if (pendingBytes > 0)
+			{
+				first = mix(first, pending, firstMultiplier);
+				second = mix(second, pending, secondMultiplier);
+			}
+
+			char text[33];
+			std::snprintf(text, sizeof(text), "%016llx%016llx", static_cast<unsigned long long>(finalize(first ^ length)), static_cast<unsigned long long>(finalize(second ^ length)));
+			return text;
+		}
+
+
+
+	private :
+
+		static constexpr uint64_t firstMultiplier = 0x9e3779b97f4a7c15ULL;
+		static constexpr uint64_t secondMultiplier = 0xc2b2ae3d27d4eb4fULL;
+
+		void mixWord(uint64_t word)
+		{
+			lanes[0] = mix(lanes[0], word, firstMultiplier);
+			lanes[1] = mix(lanes[1], word, secondMultiplier);
+		}
+
+		static uint64_t mix(uint64_t hash, uint64_t word, uint64_t multiplier)
+		{
+			hash = (hash ^ word) * multiplier;
+			return hash ^ (hash >> 31);
+		}
+
+		static uint64_t finalize(uint64_t hash)
+		{
+			hash ^= hash >> 33;
+			hash *= 0xff51afd7ed558ccdULL;
+			hash ^= hash >> 33;
+			hash *= 0xc4ceb9fe1a85ec53ULL;
+			return hash ^ (hash >> 33);
+		}
+
+		uint64_t lanes[2]{ 0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL };
+		uint64_t pending{ 0 };
+		size_t pendingBytes{ 0 };
+		uint64_t length{ 0 };
+
+};
+
+
+
+//************ A cached render mapped read-only into memory. Channel c holds getNumSamples() floats starting at getReadPointer(c). ****//
+
+class CachedRender {
+
+	public :
+
+		CachedRender()
+		{
+
+		}
+
+		~CachedRender()
+		{
+			close();
+		}
+
+		CachedRender(const CachedRender&) = delete;
+		CachedRender& operator= (const CachedRender&) = delete;
+
+
+		bool open(const std::string& path)
+		{
+			close();
+
+			const int handle = ::open(path.c_str(), O_RDONLY);
+
+			if (handle < 0)
+				return false;
+
+			struct stat status;
+			void* address = MAP_FAILED;
+
+			if (fstat(handle, &status) == 0 && static_cast<size_t>(status.st_size) >= sizeof(Header))
+			{
+				mappingSize = static_cast<size_t>(status.st_size);
+				address = mmap(nullptr, mappingSize, PROT_READ, MAP_SHARED, handle, 0);
+			}
+
+			::close(handle);
+
+			if (address == MAP_FAILED)
+				return false;
+
+			mapping = address;
+			header = static_cast<const Header*>(mapping);
+
+			if (std::memcmp(header->magic, Header::expectedMagic, sizeof(header->magic)) != 0 || header->formatVersion != RENDER_CACHE_FORMAT_VERSION
+				|| mappingSize != Header::fileSize(static_cast<int>(header->numChannels), header->numSamples))
+			{
+				close();
+				return false;
+			}
+
+			return true;
+		}
+
+		void close()
+		{
+			if (mapping != nullptr)
+				munmap(mapping, mappingSize);
+
+			mapping = nullptr;
+			header = nullptr;
+		}
+
+
+		const float* getReadPointer(int channel, int64 startSample = 0) const
+		{
+			return reinterpret_cast<const float*>(static_cast<const char*>(mapping) + sizeof(Header)) + channel * header->numSamples + startSample;
+		}
+
+		int getNumChannels() const		{ return static_cast<int>(header->numChannels); }
+		int64 getNumSamples() const		{ return header->numSamples; }
+		double getSampleRate() const	{ return header->sampleRate; }
+		size_t getSizeInBytes() const	{ return mappingSize; }
+
+
+		//************ File layout: this header, then each channel's samples in turn. 64 bytes, so the samples stay aligned. ************//
+
+		struct Header
+		{
+			static constexpr const char* expectedMagic = "JUCEFXRC";
+
+			static size_t fileSize(int numChannels, int64 numSamples)
+			{
+				return sizeof(Header) + sizeof(float) * static_cast<size_t>(numChannels) * static_cast<size_t>(numSamples);
+			}
+
+			char magic[8];
+			uint32_t formatVersion;
+			uint32_t numChannels;
+			int64 numSamples;
+			double sampleRate;
+			char reserved[32];
+		};
+
+		static_assert (sizeof(Header) == 64, "the cache header must keep the samples 64 byte aligned");
+
+
+
+	private :
+
+		void* mapping{ nullptr };
+		size_t mappingSize{ 0 };
+		const Header* header{ nullptr };
+
+};
+
+
+
+class RenderCache {
+
+	public :
+
+		struct Statistics
+		{
+			int64 hits{ 0 }, misses{ 0 };
+			int64 bytesSaved{ 0 };		// rendered output served from the cache instead of being computed
+
+			double getHitRate() const
+			{
+				return hits + misses > 0 ? static_cast<double>(hits) / static_cast<double>(hits + misses) : 0.0;
+			}
+		};
+
+
+		//************ The directory must exist. Several processes may share it: entries are written to a temporary file and renamed **//
+		//************ into place, so a reader never sees a half-written render. **********************************************************//
+
+		RenderCache(const std::string& directory, int blockSize = DEFAULT_CACHE_BLOCK_SIZE)
+			: directory(directory), blockSize(blockSize)
+		{
+
+		}
+
+
+		//************ Renders the reader through the chain into the writer, or copies a cached render of the same input and settings. *//
+		//************ The effects must already be initialized with the reader's channel count and a block size of at least the cache's //
+		//************ block size. They are reset first, so the output only depends on the input and the settings. Returns false if ****//
+		//************ reading, writing or storing the render failed, and for a chain subscribed to a ModulationBus (see ***************//
+		//************ usesModulationBus()). ***********************************************************************************************//
+
+		template <typename... Effects>
+		bool render(AudioFormatReader& reader, AudioFormatWriter& writer, ChainStage<Effects>... stages)
+		{
+			numChannels = static_cast<int>(reader.numChannels);
+
+			if (numChannels > MAX_CACHE_CHANNELS || usesModulationBus(stages...))
+				return false;
+
+			scheduler.initialize(numChannels, static_cast<int>(sizeof...(Effects)));
+
+			std::string key;
+
+			if (! makeKey(reader, key, stages...))
+				return false;
+
+			const std::string path = directory + "/" + key + ".jfxr";
+			CachedRender cached;
+
+			if (cached.open(path) && cached.getNumChannels() == numChannels && cached.getNumSamples() == reader.lengthInSamples)
+			{
+				statistics.hits++;
+				statistics.bytesSaved += static_cast<int64>(sizeof(float)) * numChannels * cached.getNumSamples();
+				return writeCached(cached, writer);
+			}
+
+			statistics.misses++;
+			(stages.effect->reset(), ...);
+			return renderToCache(reader, writer, path, stages...);
+		}
+
+
+		//************ Maps a render stored by an earlier call, e.g. to hand it to another process without a copy. *********************//
+
+		template <typename... Effects>
+		bool lookup(AudioFormatReader& reader, CachedRender& cached, ChainStage<Effects>... stages)
+		{
+			numChannels = static_cast<int>(reader.numChannels);
+			scheduler.initialize(numChannels, static_cast<int>(sizeof...(Effects)));
+
+			std::string key;
+			return makeKey(reader, key, stages...) && cached.open(directory + "/" + key + ".jfxr");
+		}
+
+		const Statistics& getStatistics() const
+		{
+			return statistics;
+		}
+
+
+
+	private :
+
+		//************ The key covers the input samples, everything that shapes the output and the library version. The tile size is ***//
+		//************ included because at control rates above 1 the modulator depends on where blocks are split. ************************//
+
+		template <typename... Effects>
+		bool makeKey(AudioFormatReader& reader, std::string& key, ChainStage<Effects>... stages)
+		{
+			RenderHash hash;
+			hash.add(RENDER_CACHE_FORMAT_VERSION);
+			hash.add(JUCE_FX_VERSION_MAJOR);
+			hash.add(JUCE_FX_VERSION_MINOR);
+			hash.add(JUCE_FX_VERSION_PATCH);
+			hash.add(blockSize);
+			hash.add(scheduler.getTileSize());
+			hash.add(numChannels);
+			hash.add(reader.lengthInSamples);
+			hash.add(reader.sampleRate);
+
+			((stages.effect->hashSettings(hash), hash.add(stages.maxDelayInSamples), hash.add(stages.gain)), ...);
+
+			AudioBuffer<float> block(numChannels, blockSize);
+
+			for (int64 position = 0; position < reader.lengthInSamples; position += blockSize)
+			{
+				const int numSamples = static_cast<int>(jmin(static_cast<int64>(blockSize), reader.lengthInSamples - position));
+
+				if (! reader.read(&block, 0, numSamples, position, true, true))
+					return false;
+
+				for (auto channel = 0; channel < numChannels; ++channel)
+					hash.add(block.getReadPointer(channel), sizeof(float) * static_cast<size_t>(numSamples));
+			}
+
+			key = hash.toString();
+			return true;
+		}
+
+
+		bool writeCached(const CachedRender& cached, AudioFormatWriter& writer) const
+		{
+			const float* channelPointers[MAX_CACHE_CHANNELS];
+
+			for (int64 position = 0; position < cached.getNumSamples(); position += blockSize)
+			{
+				const int numSamples = static_cast<int>(jmin(static_cast<int64>(blockSize), cached.getNumSamples() - position));
+
+				for (auto channel = 0; channel < numChannels; ++channel)
+					channelPointers[channel] = cached.getReadPointer(channel, position);
+
+				if (! writer.writeFromFloatArrays(channelPointers, numChannels, numSamples))
+					return false;
+			}
+
+			return true;
+		}
+
+
+		//************ The render is processed in place inside the mapped cache file: the reader fills it, the chain runs on it and the *//
+		//************ writer reads from it, so storing the result costs no extra copy. The file gets a unique temporary name (mkstemp) **//
+		//************ until it is complete, so concurrent renders of the same key, from any thread or process, never share one. *********//
+
+		template <typename... Effects>
+		bool renderToCache(AudioFormatReader& reader, AudioFormatWriter& writer, const std::string& path, ChainStage<Effects>... stages)
+		{
+			const int64 length = reader.lengthInSamples;
+			const size_t fileSize = CachedRender::Header::fileSize(numChannels, length);
+			std::string temporaryPath = path + ".tmpXXXXXX";
+
+			const int handle = mkstemp(&temporaryPath[0]);
+
+			if (handle < 0)
+				return false;
+
+			fchmod(handle, 0644);				// mkstemp creates it private; the cache is shared like the renamed file would be
+
+			void* mapping = MAP_FAILED;
+
+			if (ftruncate(handle, static_cast<off_t>(fileSize)) == 0)
+				mapping = mmap(nullptr, fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, handle, 0);
+
+			::close(handle);
+
+			if (mapping == MAP_FAILED)
+			{
+				unlink(temporaryPath.c_str());
+				return false;
+			}
+
+			float* samples = reinterpret_cast<float*>(static_cast<char*>(mapping) + sizeof(CachedRender::Header));
+			float* channelPointers[MAX_CACHE_CHANNELS];
+			AudioBuffer<float> block;
+			bool succeeded = true;
+
+			for (int64 position = 0; position < length && succeeded; position += blockSize)
+			{
+				const int numSamples = static_cast<int>(jmin(static_cast<int64>(blockSize), length - position));
+
+				for (auto channel = 0; channel < numChannels; ++channel)
+					channelPointers[channel] = samples + channel * length + position;
+
+				block.setDataToReferTo(channelPointers, numChannels, numSamples);
+
+				succeeded = reader.read(&block, 0, numSamples, position, true, true);
+
+				if (succeeded)
+				{
+					scheduler.process(&block, 0, numSamples, stages...);
+					succeeded = writer.writeFromAudioSampleBuffer(block, 0, numSamples);
+				}
+			}
+
+			auto* header = static_cast<CachedRender::Header*>(mapping);
+			std::memset(header, 0, sizeof(CachedRender::Header));
+			std::memcpy(header->magic, CachedRender::Header::expectedMagic, sizeof(header->magic));
+			header->formatVersion = RENDER_CACHE_FORMAT_VERSION;
+			header->numChannels = static_cast<uint32_t>(numChannels);
+			header->numSamples = length;
+			header->sampleRate = reader.sampleRate;
+
+			munmap(mapping, fileSize);
+
+			if (! succeeded || std::rename(temporaryPath.c_str(), path.c_str()) != 0)
+			{
+				unlink(temporaryPath.c_str());
+				return false;
+			}
+
+			return true;
+		}
+
+
+		std::string directory;
+		int blockSize;
+		int numChannels{ 0 };
+		TileScheduler scheduler;
+		Statistics statistics;
+
+};
@@ -0,0 +1,365 @@
+/***************************************************************************************
+This class implements a multi-process offline renderer (POSIX only). The file is split into one
+segment per worker process; each worker runs its own copy of the effect chain and exchanges blocks
+with the coordinator through shared-memory rings. A crashing worker fails only this render, never
+the process that called it.
+
+The workers are forked from the calling process, and fork() copies only the calling thread. A lock
+that another thread of the process holds at that moment (the allocator's, a JUCE CriticalSection,
+a logger's) stays locked forever in the worker. The workers therefore run on memory allocated before
+the fork only, take no locks and leave through _exit(); the effects' process() must be realtime safe,
+which it is. Calling render() from a multithreaded process (a plugin host, a JUCE app) is safe on
+these terms, but anything else the effects call back into (a custom DiagnosticLog, tracing with
+JUCE_FX_ENABLE_TRACING) must not lock or allocate either.
+****************************************************************************************/
+
+#pragma once
+#include <JuceHeader.h>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "ShmBlockRing.h"
+#include "SpscBlockQueue.h"
+#include "TileScheduler.h"
+
+#define DEFAULT_FARM_BLOCK_SIZE 4096
+#define DEFAULT_FARM_RING_BLOCKS 16
+#define MAX_FARM_CHANNELS 31              // AudioBuffer refers to up to 31 channels without allocating (fork safety, see above)
+
+class RenderFarm {
+
+	public :
+
+		RenderFarm(int numWorkers, int blockSize = DEFAULT_FARM_BLOCK_SIZE, int ringBlocks = DEFAULT_FARM_RING_BLOCKS)
+			: numWorkers(jmax(1, numWorkers)), blockSize(blockSize), ringBlocks(ringBlocks)
+		{
+
+		}
+
+
+		//************ Samples rendered and discarded before each segment (except the first), so the delay lines and the feedback ****//
+		//************ path hold the same history as in a single-pass render. A negative value (the default) uses the sum of the *****//
+		//************ effects' getTailSamples(), i.e. until their feedback has decayed by TAIL_DECAY (-120 dB). **********************//
+
+		void setPreRoll(int64 samples)
+		{
+			preRollSamples = samples;
+		}
+
+
+		//************ Renders the reader through the chain into the writer. The effects must already be initialized with the reader's //
+		//************ channel count and a block size of at least the farm's block size; every worker gets its own copy of them. ******//
+		//************ Returns false if a worker crashed or reading/writing failed; getFailedSegment() then tells which segment. ******//
+		//************ Segments start on multiples of the block size, so the workers see the same blocks, tiles and control segments **//
+		//************ as a single-pass render in blocks of that size. Without feedback in the chain the output is then bit-identical **//
+		//************ to such a render; with feedback, the history before the pre-roll is missing and the output differs by less ******//
+		//************ than the decay the pre-roll allows for (-120 dB by default). A chain with a stage subscribed to a ModulationBus **//
+		//************ is refused (see usesModulationBus()). ****************************************************************************//
+
+		template <typename... Effects>
+		bool render(AudioFormatReader& reader, AudioFormatWriter& writer, ChainStage<Effects>... stages)
+		{
+			numChannels = static_cast<int>(reader.numChannels);
+			failedSegment = -1;
+
+			if (numChannels > MAX_FARM_CHANNELS || usesModulationBus(stages...))
+				return false;
+
+			const int64 length = reader.lengthInSamples;
+			const int64 preRoll = preRollSamples >= 0 ? preRollSamples : (static_cast<int64>(0) + ... + stages.effect->getTailSamples());
+			const int numSegments = static_cast<int>(jmax(static_cast<int64>(1), jmin(static_cast<int64>(numWorkers), length / blockSize)));
+
+			segments.clear();
+
+			for (auto index = 0; index < numSegments; ++index)
+			{
+				auto segment = std::make_unique<Segment>();
+				segment->start = alignToBlock(length * index / numSegments);
+				segment->end = index + 1 < numSegments ? alignToBlock(length * (index + 1) / numSegments) : length;
+				segment->feedStart = alignToBlock(jmax(static_cast<int64>(0), segment->start - preRoll));
+				segment->feedPosition = segment->feedStart;
+
+				if (! segment->input.create(ringBlocks, numChannels, blockSize) || ! segment->output.create(ringBlocks, numChannels, blockSize))
+					return false;
+
+				if (index > 0 && (segment->spill = std::tmpfile()) == nullptr)
+					return false;
+
+				segments.push_back(std::move(segment));
+			}
+
+			for (auto index = 0; index < numSegments; ++index)
+			{
+				const pid_t pid = fork();
+
+				if (pid == 0)
+					runWorker(*segments[index], stages...);
+
+				if (pid < 0)
+				{
+					failedSegment = index;
+					stopWorkers();
+					return false;
+				}
+
+				segments[index]->pid = pid;
+			}
+
+			const bool succeeded = coordinate(reader, writer);
+			stopWorkers();
+			return succeeded;
+		}
+
+		int getFailedSegment() const
+		{
+			return failedSegment;
+		}
+
+
+
+	private :
+
+		struct Segment
+		{
+			~Segment()
+			{
+				if (spill != nullptr)
+					std::fclose(spill);
+			}
+
+			int64 start{ 0 }, end{ 0 };				// the part of the output this segment produces
+			int64 feedStart{ 0 }, feedPosition{ 0 };	// its input, including the pre-roll
+			ShmBlockRing input, output;
+			std::FILE* spill{ nullptr };				// output that arrives before it is this segment's turn to be written
+			pid_t pid{ -1 };
+			bool exited{ false };
+		};
+
+
+		//************ Runs in the forked child. It only touches preallocated memory (no malloc after fork), and leaves via _exit. ****//
+
+		template <typename... Effects>
+		[[noreturn]] void runWorker(Segment& segment, ChainStage<Effects>... stages)
+		{
+			(stages.effect->reset(), ...);
+			(stages.effect->setModulatorPosition(segment.feedStart), ...);
+
+			TileScheduler scheduler;
+			scheduler.initialize(numChannels, static_cast<int>(sizeof...(Effects)));
+
+			AudioBuffer<float> block;
+			float* channelPointers[MAX_FARM_CHANNELS];
+			int64 position = segment.feedStart;
+			int attempt = 0;
+
+			for (;;)
+			{
+				int numSamples = 0;
+				float* input = segment.input.beginRead(numSamples);
+
+				if (input == nullptr)
+				{
+					if (segment.input.isDrained())
+						break;
+
+					SpscBlockQueue::wait(attempt);
+					continue;
+				}
+
+				attempt = 0;
+				referToBlock(block, channelPointers, input, numSamples);
+				scheduler.process(&block, 0, numSamples, stages...);
+
+				if (position >= segment.start)			// pre-roll blocks end exactly at segment.start and are dropped
+				{
+					float* output;
+
+					while ((output = segment.output.beginWrite()) == nullptr)
+						SpscBlockQueue::wait(attempt);
+
+					attempt = 0;
+					std::memcpy(output, input, sizeof(float) * static_cast<size_t>(numChannels) * static_cast<size_t>(blockSize));
+					segment.output.endWrite(numSamples);
+				}
+
+				segment.input.endRead();
+				position += numSamples;
+			}
+
+			segment.output.finish();
+			_exit(0);
+		}
+
+
+		//************ The coordinator feeds every worker from the reader, writes the current segment's output straight to the writer, *//
+		//************ and spills the output of later segments to temporary files until it is their turn, so no worker has to wait ****//
+		//************ for the writer. *************************************************************************************************//
+
+		bool coordinate(AudioFormatReader& reader, AudioFormatWriter& writer)
+		{
+			AudioBuffer<float> block;
+			float* channelPointers[MAX_FARM_CHANNELS];
+			size_t current = 0;
+			int attempt = 0;
+
+			while (current < segments.size())
+			{
+				bool progress = false;
+
+				for (auto index = current; index < segments.size(); ++index)
+				{
+					Segment& segment = *segments[index];
+
+					while (segment.feedPosition < segment.end)
+					{
+						float* slot = segment.input.beginWrite();
+
+						if (slot == nullptr)
+							break;
+
+						const int64 boundary = segment.feedPosition < segment.start ? segment.start : segment.end;
+						const int numSamples = static_cast<int>(jmin(static_cast<int64>(blockSize), boundary - segment.feedPosition));
+
+						referToBlock(block, channelPointers, slot, numSamples);
+
+						if (! reader.read(&block, 0, numSamples, segment.feedPosition, true, true))
+							return false;
+
+						segment.input.endWrite(numSamples);
+						segment.feedPosition += numSamples;
+						progress = true;
+
+						if (segment.feedPosition == segment.end)
+							segment.input.finish();
+					}
+
+					int numSamples = 0;
+
+					while (float* slot = segment.output.beginRead(numSamples))
+					{
+						if (! (index == current ? writeBlock(writer, block, channelPointers, slot, numSamples) : spillBlock(segment, slot, numSamples)))
+							return false;
+
+						segment.output.endRead();
+						progress = true;
+					}
+
+					if (! checkWorker(segment))
+					{
+						failedSegment = static_cast<int>(index);
+						return false;
+					}
+				}
+
+				if (segments[current]->output.isDrained())
+				{
+					if (++current < segments.size() && ! replaySpill(*segments[current], writer, block, channelPointers))
+						return false;
+
+					progress = true;
+				}
+
+				if (progress)
+					attempt = 0;
+				else
+					SpscBlockQueue::wait(attempt);
+			}
+
+			return true;
+		}
+
+
+		//************ A worker that has exited without finishing its output has crashed (or was killed) ******************************//
+
+		bool checkWorker(Segment& segment)
+		{
+			if (segment.exited)
+				return true;
+
+			int status = 0;
+
+			if (waitpid(segment.pid, &status, WNOHANG) != segment.pid)
+				return true;
+
+			segment.exited = true;
+			return WIFEXITED(status) && WEXITSTATUS(status) == 0 && segment.output.isFinished();
+		}
+
+		void stopWorkers()
+		{
+			for (auto& segment : segments)
+			{
+				if (segment->pid > 0 && ! segment->exited)
+				{
+					kill(segment->pid, SIGKILL);
+					waitpid(segment->pid, nullptr, 0);
+					segment->exited = true;
+				}
+			}
+		}
+
+
+		int64 alignToBlock(int64 position) const
+		{
+			return position - position % blockSize;
+		}
+
+		void referToBlock(AudioBuffer<float>& block, float** channelPointers, float* slot, int numSamples) const
+		{
+			for (auto channel = 0; channel < numChannels; ++channel)
+				channelPointers[channel] = slot + static_cast<size_t>(channel) * static_cast<size_t>(blockSize);
+
+			block.setDataToReferTo(channelPointers, numChannels, numSamples);
+		}
+
+		bool writeBlock(AudioFormatWriter& writer, AudioBuffer<float>& block, float** channelPointers, float* slot, int numSamples) const
+		{
+			referToBlock(block, channelPointers, slot, numSamples);
+			return writer.writeFromAudioSampleBuffer(block, 0, numSamples);
+		}
+
+		bool spillBlock(Segment& segment, const float* slot, int numSamples) const
+		{
+			if (std::fwrite(&numSamples, sizeof(int), 1, segment.spill) != 1)
+				return false;
+
+			for (auto channel = 0; channel < numChannels; ++channel)
+				if (std::fwrite(slot + static_cast<size_t>(channel) * static_cast<size_t>(blockSize), sizeof(float), static_cast<size_t>(numSamples), segment.spill) != static_cast<size_t>(numSamples))
+					return false;
+
+			return true;
+		}
+
+		bool replaySpill(Segment& segment, AudioFormatWriter& writer, AudioBuffer<float>& block, float** channelPointers) const
+		{
+			std::vector<float> slot(static_cast<size_t>(numChannels) * static_cast<size_t>(blockSize));
+			std::rewind(segment.spill);
+			int numSamples = 0;
+
+			while (std::fread(&numSamples, sizeof(int), 1, segment.spill) == 1)
+			{
+				for (auto channel = 0; channel < numChannels; ++channel)
+					if (std::fread(slot.data() + static_cast<size_t>(channel) * static_cast<size_t>(blockSize), sizeof(float), static_cast<size_t>(numSamples), segment.spill) != static_cast<size_t>(numSamples))
+						return false;
+
+				if (! writeBlock(writer, block, channelPointers, slot.data(), numSamples))
+					return false;
+			}
+
+			std::fclose(segment.spill);
+			segment.spill = nullptr;
+			return true;
+		}
+
+
+		int numWorkers, blockSize, ringBlocks;
+		int64 preRollSamples{ -1 };
+		int numChannels{ 0 };
+		int failedSegment{ -1 };
+		std::vector<std::unique_ptr<Segment>> segments;
+
+};
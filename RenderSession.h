@@ -0,0 +1,210 @@
+/***************************************************************************************
+This class implements an editable offline render. While rendering it stores checkpoints of
+the chain state (see saveState) every few seconds; after an edit, only the part between the
+last checkpoint before the edit and the point where the new render converges with the old
+one is rendered again.
+****************************************************************************************/
+
+#pragma once
+#include <JuceHeader.h>
+#include <functional>
+#include <limits>
+#include <tuple>
+#include <vector>
+#include "TileScheduler.h"
+
+#define DEFAULT_SESSION_BLOCK_SIZE 4096
+#define DEFAULT_CHECKPOINT_SECONDS 10.0
+#define MAX_SESSION_CHANNELS 32
+
+template <typename... Effects>
+class RenderSession {
+
+	public :
+
+		struct RenderedRange
+		{
+			int64 start{ 0 }, end{ 0 };		// the samples of getOutput() that changed
+		};
+
+
+		//************ The effects must already be initialized with the reader's channel count and a block size of at least *************//
+		//************ DEFAULT_SESSION_BLOCK_SIZE. The checkpoint interval is rounded up to whole blocks; 0 uses DEFAULT_CHECKPOINT_SECONDS. //
+
+		RenderSession(AudioFormatReader& reader, int64 checkpointInterval, ChainStage<Effects>... stages)
+			: reader(reader), stages(stages...)
+		{
+			numChannels = static_cast<int>(reader.numChannels);
+			length = reader.lengthInSamples;
+
+			if (checkpointInterval <= 0)
+				checkpointInterval = static_cast<int64>(DEFAULT_CHECKPOINT_SECONDS * reader.sampleRate);
+
+			interval = (checkpointInterval + blockSize - 1) / blockSize * blockSize;
+			scheduler.initialize(numChannels, static_cast<int>(sizeof...(Effects)));
+		}
+
+
+		//************ Called with the position of every block before it is processed, so the owner can set the parameters that apply ***//
+		//************ there (automation). Without it, the parameters stay whatever they are. ***********************************************//
+
+		void setAutomation(std::function<void(int64)> callback)
+		{
+			automation = std::move(callback);
+		}
+
+
+		//************ Renders the whole file from a fresh state and stores a checkpoint every interval. Returns false if reading failed, **//
+		//************ or without rendering anything if the file has more than MAX_SESSION_CHANNELS channels or more samples than an ******//
+		//************ AudioBuffer can hold (INT_MAX), or if a stage is subscribed to a ModulationBus (see usesModulationBus()). ***********//
+
+		bool render()
+		{
+			if (numChannels > MAX_SESSION_CHANNELS || length < 0 || length > std::numeric_limits<int>::max() || subscribedToModulationBus())
+				return false;
+
+			output.setSize(numChannels, static_cast<int>(length));
+			checkpoints.assign(static_cast<size_t>(length / interval + 1), std::vector<char>());
+			std::apply([] (auto&... stage) { (stage.effect->reset(), ...); }, stages);
+
+			lastRendered = { 0, 0 };
+
+			for (int64 position = 0; position < length; position += blockSize)
+			{
+				if (position % interval == 0)
+					saveCheckpoint(checkpoints[static_cast<size_t>(position / interval)]);
+
+				if (! renderBlock(position))
+					return false;
+
+				lastRendered.end = position + jmin(static_cast<int64>(blockSize), length - position);
+			}
+
+			return true;
+		}
+
+
+		//************ Renders again after the automation between editStart and editEnd changed. Rendering restarts from the last ******//
+		//************ checkpoint before editStart and stops at the first checkpoint after editEnd whose chain state is bit-identical ****//
+		//************ to the stored one: from there on the new render cannot differ from the old. With feedback or a changed LFO rate ***//
+		//************ the state rarely matches again, and the render runs to the end. getLastRenderedRange() tells what changed. *********//
+
+		bool rerender(int64 editStart, int64 editEnd)
+		{
+			if (checkpoints.empty())
+				return render();
+
+			if (subscribedToModulationBus())
+				return false;
+
+			const int64 start = jlimit(static_cast<int64>(0), length, editStart) / interval * interval;
+			lastRendered = { start, start };
+
+			if (start < length && ! restoreCheckpoint(checkpoints[static_cast<size_t>(start / interval)]))
+				return false;
+
+			for (int64 position = start; position < length; position += blockSize)
+			{
+				if (position % interval == 0 && position > start)
+				{
+					auto& checkpoint = checkpoints[static_cast<size_t>(position / interval)];
+					saveCheckpoint(scratch);
+
+					if (position >= editEnd && scratch == checkpoint)
+						return true;
+
+					checkpoint.swap(scratch);
+				}
+
+				if (! renderBlock(position))
+					return false;
+
+				lastRendered.end = position + jmin(static_cast<int64>(blockSize), length - position);
+			}
+
+			return true;
+		}
+
+		const AudioBuffer<float>& getOutput() const
+		{
+			return output;
+		}
+
+		RenderedRange getLastRenderedRange() const
+		{
+			return lastRendered;
+		}
+
+
+
+	private :
+
+		//************ The block is read straight into the output buffer and processed in place there **********************************//
+
+		bool renderBlock(int64 position)
+		{
+			const int numSamples = static_cast<int>(jmin(static_cast<int64>(blockSize), length - position));
+
+			for (auto channel = 0; channel < numChannels; ++channel)
+				channelPointers[channel] = output.getWritePointer(channel, static_cast<int>(position));
+
+			block.setDataToReferTo(channelPointers, numChannels, numSamples);
+
+			if (! reader.read(&block, 0, numSamples, position, true, true))
+				return false;
+
+			if (automation)
+				automation(position);
+
+			std::apply([&] (auto&... stage) { scheduler.process(&block, 0, numSamples, stage...); }, stages);
+			return true;
+		}
+
+		bool subscribedToModulationBus() const
+		{
+			return std::apply([] (auto... stage) { return usesModulationBus(stage...); }, stages);
+		}
+
+		//************ A checkpoint is the saved states of all stages, one after the other ***********************************************//
+
+		void saveCheckpoint(std::vector<char>& checkpoint)
+		{
+			size_t size = 0;
+			std::apply([&] (auto&... stage) { ((size += stage.effect->getStateSize()), ...); }, stages);
+			checkpoint.resize(size);
+
+			char* bytes = checkpoint.data();
+			std::apply([&] (auto&... stage) { ((bytes += stage.effect->saveState(bytes, stage.effect->getStateSize())), ...); }, stages);
+		}
+
+		bool restoreCheckpoint(const std::vector<char>& checkpoint)
+		{
+			const char* bytes = checkpoint.data();
+			bool restored = true;
+
+			std::apply([&] (auto&... stage)
+			{
+				((restored = restored && stage.effect->restoreState(bytes, stage.effect->getStateSize()), bytes += stage.effect->getStateSize()), ...);
+			}, stages);
+
+			return restored;
+		}
+
+
+		AudioFormatReader& reader;
+		std::tuple<ChainStage<Effects>...> stages;
+		std::function<void(int64)> automation;
+
+		int numChannels{ 0 };
+		int64 length{ 0 };
+		int blockSize{ DEFAULT_SESSION_BLOCK_SIZE };
+		int64 interval{ 0 };
+
+		TileScheduler scheduler;
+		AudioBuffer<float> output, block;
+		float* channelPointers[MAX_SESSION_CHANNELS];
+		std::vector<std::vector<char>> checkpoints;
+		std::vector<char> scratch;
+		RenderedRange lastRendered;
+
+};
@@ -0,0 +1,167 @@
+/***************************************************************************************
+This class implements a single-producer/single-consumer ring of audio blocks in POSIX shared
+memory, so blocks can be exchanged with a forked worker process without pipes or copies through
+the kernel. Same protocol as SpscBlockQueue; blocks are planar (numChannels x blockSize floats).
+****************************************************************************************/
+
+#pragma once
+#include <JuceHeader.h>
+#include <atomic>
+#include <cstdio>
+#include <new>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+class ShmBlockRing {
+
+	public :
+
+		ShmBlockRing()
+		{
+
+		}
+
+		~ShmBlockRing()
+		{
+			release();
+		}
+
+		ShmBlockRing(const ShmBlockRing&) = delete;
+		ShmBlockRing& operator= (const ShmBlockRing&) = delete;
+
+
+		//************* Creates the shared segment. The name is unlinked right after mapping: forked workers inherit the mapping, ******//
+		//************* and nothing is left behind in /dev/shm when a process crashes. ***************************************************//
+
+		bool create(int numSlots, int numChannels, int blockSize)
+		{
+			static std::atomic<unsigned int> counter{ 0 };
+			char name[64];
+			std::snprintf(name, sizeof(name), "/juce_fx_%d_%u", static_cast<int>(getpid()), counter++);
+
+			const int handle = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+
+			if (handle < 0)
+				return false;
+
+			shm_unlink(name);
+
+			slotSize = static_cast<size_t>(numChannels) * static_cast<size_t>(blockSize);
+			const size_t dataOffset = (sizeof(Header) + sizeof(int) * static_cast<size_t>(numSlots) + 63) & ~static_cast<size_t>(63);
+			mappingSize = dataOffset + sizeof(float) * slotSize * static_cast<size_t>(numSlots);
+
+			void* address = MAP_FAILED;
+
+			if (ftruncate(handle, static_cast<off_t>(mappingSize)) == 0)
+				address = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, handle, 0);
+
+			close(handle);
+
+			if (address == MAP_FAILED)
+				return false;
+
+			mapping = address;
+			header = new (mapping) Header();
+			lengths = reinterpret_cast<int*>(static_cast<char*>(mapping) + sizeof(Header));
+			data = reinterpret_cast<float*>(static_cast<char*>(mapping) + dataOffset);
+
+			slots = static_cast<size_t>(numSlots);
+			channels = numChannels;
+			samplesPerBlock = blockSize;
+			return true;
+		}
+
+		void release()
+		{
+			if (mapping != nullptr)
+				munmap(mapping, mappingSize);
+
+			mapping = nullptr;
+			header = nullptr;
+		}
+
+
+		//************* Producer side: the next free block (channel c starts at c * getBlockSize()), or nullptr while the ring is full *//
+
+		float* beginWrite()
+		{
+			const size_t write = header->writeIndex.load(std::memory_order_relaxed);
+
+			if (write - header->readIndex.load(std::memory_order_acquire) == slots)
+				return nullptr;
+
+			return data + (write % slots) * slotSize;
+		}
+
+		void endWrite(int numSamples)
+		{
+			const size_t write = header->writeIndex.load(std::memory_order_relaxed);
+			lengths[write % slots] = numSamples;
+			header->writeIndex.store(write + 1, std::memory_order_release);
+		}
+
+		void finish()
+		{
+			header->finished.store(1, std::memory_order_release);
+		}
+
+
+		//************* Consumer side: the oldest published block and its length, or nullptr while the ring is empty *******************//
+
+		float* beginRead(int& numSamples)
+		{
+			const size_t read = header->readIndex.load(std::memory_order_relaxed);
+
+			if (read == header->writeIndex.load(std::memory_order_acquire))
+				return nullptr;
+
+			numSamples = lengths[read % slots];
+			return data + (read % slots) * slotSize;
+		}
+
+		void endRead()
+		{
+			header->readIndex.store(header->readIndex.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+		}
+
+		bool isFinished() const
+		{
+			return header->finished.load(std::memory_order_acquire) != 0;
+		}
+
+		bool isDrained() const
+		{
+			return isFinished() && header->readIndex.load(std::memory_order_acquire) == header->writeIndex.load(std::memory_order_acquire);
+		}
+
+
+		int getNumChannels() const		{ return channels; }
+		int getBlockSize() const		{ return samplesPerBlock; }
+
+
+
+	private :
+
+		//************* Lives at the start of the shared segment. The atomics must be lock-free to work across processes. ***************//
+
+		struct Header
+		{
+			alignas(64) std::atomic<size_t> writeIndex{ 0 };
+			alignas(64) std::atomic<size_t> readIndex{ 0 };
+			std::atomic<int> finished{ 0 };
+		};
+
+		static_assert (std::atomic<size_t>::is_always_lock_free && std::atomic<int>::is_always_lock_free, "shared memory atomics must be lock-free");
+
+
+		void* mapping{ nullptr };
+		size_t mappingSize{ 0 };
+		Header* header{ nullptr };
+		int* lengths{ nullptr };
+		float* data{ nullptr };
+
+		size_t slots{ 0 }, slotSize{ 0 };
+		int channels{ 0 }, samplesPerBlock{ 0 };
+
+};
@@ -0,0 +1,116 @@
+/***************************************************************************************
+This class implements a lock-free single-producer/single-consumer queue of audio blocks.
+All blocks are allocated up front; producer and consumer fill and drain them in place.
+****************************************************************************************/
+
+#pragma once
+#include <JuceHeader.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+class SpscBlockQueue {
+
+	public :
+
+		SpscBlockQueue()
+		{
+
+		}
+
+
+		//************* Allocates numBlocks blocks of numChannels x blockSize samples. Not thread safe, call before the threads start. ***//
+
+		void initialize(int numBlocks, int numChannels, int blockSize)
+		{
+			blocks.resize(numBlocks);
+			blockLengths.assign(numBlocks, 0);
+
+			for (auto& block : blocks)
+				block.setSize(numChannels, blockSize);
+
+			writeIndex.store(0);
+			readIndex.store(0);
+			finished.store(false);
+		}
+
+
+		//************* Producer side: returns the next free block, or nullptr while the queue is full (back-pressure). After filling ****//
+		//************* it, publish it with endWrite(). The last block of the stream is flagged with finish(). ****************************//
+
+		AudioBuffer<float>* beginWrite()
+		{
+			const size_t write = writeIndex.load(std::memory_order_relaxed);
+
+			if (write - readIndex.load(std::memory_order_acquire) == blocks.size())
+				return nullptr;
+
+			return &blocks[write % blocks.size()];
+		}
+
+		void endWrite(int numSamples)
+		{
+			const size_t write = writeIndex.load(std::memory_order_relaxed);
+			blockLengths[write % blocks.size()] = numSamples;
+			writeIndex.store(write + 1, std::memory_order_release);
+		}
+
+		void finish()
+		{
+			finished.store(true, std::memory_order_release);
+		}
+
+
+		//************* Consumer side: returns the oldest published block and its length, or nullptr while the queue is empty. Hand ****//
+		//************* it back with endRead() once done with it. *********************************************************************//
+
+		AudioBuffer<float>* beginRead(int& numSamples)
+		{
+			const size_t read = readIndex.load(std::memory_order_relaxed);
+
+			if (read == writeIndex.load(std::memory_order_acquire))
+				return nullptr;
+
+			numSamples = blockLengths[read % blocks.size()];
+			return &blocks[read % blocks.size()];
+		}
+
+		void endRead()
+		{
+			readIndex.store(readIndex.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+		}
+
+		//************* True once the producer called finish() and every block has been read ********************************************//
+
+		bool isDrained() const
+		{
+			return finished.load(std::memory_order_acquire) && readIndex.load(std::memory_order_acquire) == writeIndex.load(std::memory_order_acquire);
+		}
+
+
+		//************* Backoff for a stage that found its queue full or empty: spin briefly, then yield, then sleep. ******************//
+
+		static void wait(int& attempt)
+		{
+			if (++attempt < 64)
+				return;
+
+			if (attempt < 128)
+				std::this_thread::yield();
+			else
+				std::this_thread::sleep_for(std::chrono::microseconds(50));
+		}
+
+
+
+	private :
+
+		std::vector<AudioBuffer<float>> blocks;
+		std::vector<int> blockLengths;
+
+		alignas(64) std::atomic<size_t> writeIndex{ 0 };		// separate cache lines, so producer and consumer do not share one
+		alignas(64) std::atomic<size_t> readIndex{ 0 };
+		std::atomic<bool> finished{ false };
+
+};
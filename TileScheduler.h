@@ -0,0 +1,208 @@
+/***************************************************************************************
+This class implements a cache-blocked scheduler that runs a chain of effects (Flanger, PitchShifter, ...)
+over all channels of a buffer in small tiles, instead of streaming each channel's full block at once
+****************************************************************************************/
+
+#pragma once
+#include <JuceHeader.h>
+#include <type_traits>
+#include <utility>
+
+#if JUCE_LINUX
+ #include <unistd.h>
+#endif
+
+#define DEFAULT_L1_CACHE_SIZE 32768        // in bytes, used when the cache size cannot be queried
+#define MIN_TILE_SIZE 16
+#define MAX_TILE_SIZE 1024
+
+
+//************* One effect of the chain, together with the arguments its process() callback needs ***************************//
+
+template <typename Effect>
+struct ChainStage
+{
+	Effect* effect;
+	int maxDelayInSamples;
+	float gain;
+};
+
+template <typename Effect>
+ChainStage<Effect> makeChainStage(Effect& effect, int maxDelayInSamples, float gain)
+{
+	return { &effect, maxDelayInSamples, gain };
+}
+
+
+//************* True for effects that offer the fixed block size callback process<BlockSize>(...) ******************************//
+
+template <typename Effect, typename = void>
+struct HasFixedBlockProcess : std::false_type {};
+
+template <typename Effect>
+struct HasFixedBlockProcess<Effect, std::void_t<decltype(std::declval<Effect&>().template process<MIN_TILE_SIZE>(nullptr, 0, 0, 0, 0.0f))>> : std::true_type {};
+
+
+//************* True for effects that can take their LFO from a ModulationBus (see Flanger::setModulationBus) *************************//
+
+template <typename Effect, typename = void>
+struct HasModulationBus : std::false_type {};
+
+template <typename Effect>
+struct HasModulationBus<Effect, std::void_t<decltype(std::declval<const Effect&>().getModulationBus())>> : std::true_type {};
+
+//************* True if a stage reads its LFO from a ModulationBus. The offline renderers refuse such chains: they own no bus to ****//
+//************* render, and a bus rendered by someone else does not follow their blocks. *********************************************//
+
+template <typename... Effects>
+bool usesModulationBus(ChainStage<Effects>... stages)
+{
+	const auto subscribed = [] (const auto* effect)
+	{
+		if constexpr (HasModulationBus<std::decay_t<decltype(*effect)>>::value)
+			return effect->getModulationBus() != nullptr;
+		else
+			return false;
+	};
+
+	return (false || ... || subscribed(stages.effect));
+}
+
+
+class TileScheduler {
+
+	public :
+
+		TileScheduler()
+		{
+
+		}
+
+
+		//************* Picks the tile size for the given chain layout. Pass 0 as cache size to use the L1 data cache of this machine. *****//
+
+		void initialize(int numChannels, int numStages, int cacheSizeInBytes = 0)
+		{
+			if (cacheSizeInBytes <= 0)
+				cacheSizeInBytes = getL1CacheSize();
+
+			tileSize = chooseTileSize(numChannels, numStages, cacheSizeInBytes);
+		}
+
+
+		//************* Per tile, every channel touches its slice of the I/O buffer, and every stage writes one tile into its delay and ****//
+		//************* feedback rings. We take the largest power-of-two tile for which that data still fits in the cache, so each stage ****//
+		//************* and channel finds what the previous one produced still hot. The read-back window behind the write position is ****//
+		//************* shared between consecutive tiles and is not counted. *********************************************************//
+
+		static int chooseTileSize(int numChannels, int numStages, int cacheSizeInBytes)
+		{
+			int tile = MAX_TILE_SIZE;
+
+			while (tile > MIN_TILE_SIZE && static_cast<int>(sizeof(float)) * numChannels * tile * (1 + 2 * numStages) > cacheSizeInBytes)
+				tile /= 2;
+
+			return tile;
+		}
+
+
+		static int getL1CacheSize()
+		{
+		   #if JUCE_LINUX && defined (_SC_LEVEL1_DCACHE_SIZE)
+			const long size = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+			if (size > 0)
+				return static_cast<int>(size);
+		   #endif
+
+			return DEFAULT_L1_CACHE_SIZE;
+		}
+
+
+		//************ Runs the chain over numSamples samples of the buffer. Within each tile, the stages run in chain order, each over *****//
+		//************ all channels, and advance their write positions by the tile length. The effects must have been initialized with ****//
+		//************ at least as many channels as the buffer has and a block size of at least the tile size. *****************************//
+
+		template <typename... Effects>
+		void process(AudioBuffer<float>* inbuffer, int startSample, int numSamples, ChainStage<Effects>... stages)
+		{
+			const int numChannels = inbuffer->getNumChannels();
+			const int endSample = startSample + numSamples;
+
+			for (auto tileStart = startSample; tileStart < endSample; tileStart += tileSize)
+			{
+				const int tileLength = jmin(tileSize, endSample - tileStart);
+				(processStage(inbuffer, tileStart, tileLength, numChannels, stages), ...);
+			}
+		}
+
+
+		int getTileSize() const
+		{
+			return tileSize;
+		}
+
+		void setTileSize(int newTileSize)
+		{
+			tileSize = jlimit(MIN_TILE_SIZE, MAX_TILE_SIZE, newTileSize);
+		}
+
+
+		//************ With fixed tile kernels, full tiles go to the effects' process<TileSize>(...) callback (compile-time trip counts, **//
+		//************ compare instead of modulo on the ring indices) when the tile size is a power of two. The output is the same; ******//
+		//************ which variant is faster depends on the machine (see KernelAutotuner). ***********************************************//
+
+		void setFixedTileKernels(bool shouldUseFixedTileKernels)
+		{
+			fixedTileKernels = shouldUseFixedTileKernels;
+		}
+
+		bool usesFixedTileKernels() const
+		{
+			return fixedTileKernels;
+		}
+
+
+
+	private :
+
+		template <typename Effect>
+		void processStage(AudioBuffer<float>* inbuffer, int tileStart, int tileLength, int numChannels, ChainStage<Effect>& stage) const
+		{
+			if constexpr (HasFixedBlockProcess<Effect>::value)
+			{
+				if (fixedTileKernels && tileLength == tileSize)
+				{
+					switch (tileSize)
+					{
+						case 16:	processFixedTile<16>(inbuffer, tileStart, numChannels, stage);		return;
+						case 32:	processFixedTile<32>(inbuffer, tileStart, numChannels, stage);		return;
+						case 64:	processFixedTile<64>(inbuffer, tileStart, numChannels, stage);		return;
+						case 128:	processFixedTile<128>(inbuffer, tileStart, numChannels, stage);		return;
+						case 256:	processFixedTile<256>(inbuffer, tileStart, numChannels, stage);		return;
+						case 512:	processFixedTile<512>(inbuffer, tileStart, numChannels, stage);		return;
+						case 1024:	processFixedTile<1024>(inbuffer, tileStart, numChannels, stage);	return;
+						default:	break;
+					}
+				}
+			}
+
+			for (auto channel = 0; channel < numChannels; ++channel)
+				stage.effect->process(inbuffer, tileStart, tileLength, stage.maxDelayInSamples, channel, stage.gain);
+
+			stage.effect->adjustWritePositions(tileLength);
+		}
+
+		template <int TileSize, typename Effect>
+		static void processFixedTile(AudioBuffer<float>* inbuffer, int tileStart, int numChannels, ChainStage<Effect>& stage)
+		{
+			for (auto channel = 0; channel < numChannels; ++channel)
+				stage.effect->template process<TileSize>(inbuffer, tileStart, stage.maxDelayInSamples, channel, stage.gain);
+
+			stage.effect->adjustWritePositions(TileSize);
+		}
+
+
+		int tileSize{ 64 };
+		bool fixedTileKernels{ false };
+
+};
@@ -0,0 +1,13 @@
+/***************************************************************************************
+Version of the effects library. It is part of every RenderCache key and is reported by the C
+interface (juce_fx_version). Plain C, so the C header can include it.
+****************************************************************************************/
+
+#ifndef JUCE_FX_VERSION_H
+#define JUCE_FX_VERSION_H
+
+#define JUCE_FX_VERSION_MAJOR 1
+#define JUCE_FX_VERSION_MINOR 0
+#define JUCE_FX_VERSION_PATCH 0
+
+#endif
@@ -0,0 +1,348 @@
+/***************************************************************************************
+Standalone JACK client running a Flanger -> PitchShifter chain on a stereo stream.
+Parameters arrive as text datagrams on a local UDP control socket, e.g.
+
+    echo "flanger.depth 0.5" | nc -u -w0 127.0.0.1 9010
+
+and are handed to the realtime thread through lock-free atomics. The process callback
+never allocates, locks or makes system calls. When it gets close to its deadline, a load
+governor lowers the effects' quality tiers instead of letting JACK run into xruns.
+
+Built with JUCE_FX_ENABLE_TRACING=1, it writes a Chrome trace of every callback and DSP stage
+to the file named by the JUCE_FX_TRACE environment variable.
+****************************************************************************************/
+
+#include <jack/jack.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include "../../DiagnosticLog.h"
+#include "../../DspTrace.h"
+#include "../../Flanger.h"
+#include "../../LoadGovernor.h"
+#include "../../PitchShifter.h"
+
+#define NUM_CHANNELS 2
+#define DEFAULT_CONTROL_PORT 9010
+
+
+//************* Control parameters, written by the control thread and read once per JACK cycle ********************************//
+
+enum Parameter { flangerEnabled, flangerDepth, flangerFeedback, flangerRate, flangerRange, pitchEnabled, pitchRate, pitchUp, pitchRange, outputGain, numParameters };
+
+struct ParameterInfo
+{
+    const char* name;
+    float minValue, maxValue, defaultValue;
+};
+
+static const ParameterInfo parameterInfos[numParameters] =
+{
+    { "flanger.enabled",  0.0f,  1.0f,  1.0f },
+    { "flanger.depth",    0.0f,  1.0f,  0.7f },
+    { "flanger.feedback", 0.0f,  0.95f, 0.0f },
+    { "flanger.rate",     0.05f, 10.0f, 0.5f },
+    { "flanger.range_ms", 0.1f,  9.5f,  5.0f },
+    { "pitch.enabled",    0.0f,  1.0f,  0.0f },
+    { "pitch.rate",       0.0f,  50.0f, 5.0f },
+    { "pitch.up",         0.0f,  1.0f,  1.0f },
+    { "pitch.range_ms",   0.1f,  9.5f,  5.0f },
+    { "gain",             0.0f,  2.0f,  1.0f }
+};
+
+static_assert (std::atomic<float>::is_always_lock_free, "parameters must be lock-free for the realtime thread");
+
+
+class JackEffectChain {
+
+public:
+
+    JackEffectChain()
+    {
+        for (auto i = 0; i < numParameters; ++i)
+            parameters[i].store(parameterInfos[i].defaultValue);
+
+        governor.addInstance(flanger);
+        governor.addInstance(pitchShifter);
+
+        flanger.setDiagnosticLog(&diagnostics);
+        pitchShifter.setDiagnosticLog(&diagnostics);
+    }
+
+    bool open(const char* clientName)
+    {
+        jack_status_t status;
+        client = jack_client_open(clientName, JackNullOption, &status);
+
+        if (client == nullptr)
+        {
+            std::fprintf(stderr, "jack_client_open failed (status 0x%x), is jackd running?\n", static_cast<unsigned>(status));
+            return false;
+        }
+
+        for (auto channel = 0; channel < NUM_CHANNELS; ++channel)
+        {
+            char name[16];
+            std::snprintf(name, sizeof(name), "in_%d", channel + 1);
+            inputPorts[channel] = jack_port_register(client, name, JACK_DEFAULT_AUDIO_TYPE, JackPortIsInput, 0);
+            std::snprintf(name, sizeof(name), "out_%d", channel + 1);
+            outputPorts[channel] = jack_port_register(client, name, JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput, 0);
+
+            if (inputPorts[channel] == nullptr || outputPorts[channel] == nullptr)
+            {
+                std::fprintf(stderr, "could not register ports\n");
+                return false;
+            }
+        }
+
+        sampleRate = jack_get_sample_rate(client);
+        prepare(jack_get_buffer_size(client));
+
+        jack_set_process_callback(client, processCallback, this);
+        jack_set_buffer_size_callback(client, bufferSizeCallback, this);
+        jack_on_shutdown(client, shutdownCallback, this);
+
+        diagnostics.start();
+        return jack_activate(client) == 0;
+    }
+
+    void close()
+    {
+        if (client != nullptr)
+        {
+            jack_deactivate(client);
+            jack_client_close(client);
+            client = nullptr;
+        }
+
+        diagnostics.stop();
+    }
+
+    //************ Values are clamped to the parameter's range. NaN and infinities are refused: jlimit lets NaN through. *********//
+
+    bool setParameter(const char* name, float value)
+    {
+        if (! std::isfinite(value))
+            return false;
+
+        for (auto i = 0; i < numParameters; ++i)
+        {
+            if (std::strcmp(name, parameterInfos[i].name) == 0)
+            {
+                parameters[i].store(jlimit(parameterInfos[i].minValue, parameterInfos[i].maxValue, value));
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    std::atomic<bool> shutdown{ false };
+
+private:
+
+    //************ Allocates the delay lines. JACK only calls this while the process callback is not running. ********************//
+
+    void prepare(jack_nframes_t bufferSize)
+    {
+        flanger.initialize(static_cast<int>(bufferSize), sampleRate, NUM_CHANNELS);
+        pitchShifter.initialize(static_cast<int>(bufferSize), sampleRate, NUM_CHANNELS);
+    }
+
+    static int bufferSizeCallback(jack_nframes_t bufferSize, void* arg)
+    {
+        static_cast<JackEffectChain*>(arg)->prepare(bufferSize);
+        return 0;
+    }
+
+    static void shutdownCallback(void* arg)
+    {
+        static_cast<JackEffectChain*>(arg)->shutdown.store(true);
+    }
+
+    static int processCallback(jack_nframes_t numFrames, void* arg)
+    {
+        static_cast<JackEffectChain*>(arg)->process(static_cast<int>(numFrames));
+        return 0;
+    }
+
+
+    //************ The realtime callback: pull the current parameters, copy the inputs to the outputs and run the chain in place **//
+
+    void process(int numFrames)
+    {
+        governor.beginCallback();
+        JUCE_FX_TRACE_THREAD_NAME("JACK process");
+        JUCE_FX_TRACE_SCOPE("JACK callback", -1);
+
+        float* channels[NUM_CHANNELS];
+
+        for (auto channel = 0; channel < NUM_CHANNELS; ++channel)
+        {
+            const auto* input = static_cast<const float*>(jack_port_get_buffer(inputPorts[channel], static_cast<jack_nframes_t>(numFrames)));
+            channels[channel] = static_cast<float*>(jack_port_get_buffer(outputPorts[channel], static_cast<jack_nframes_t>(numFrames)));
+            std::memcpy(channels[channel], input, sizeof(float) * static_cast<size_t>(numFrames));
+        }
+
+        buffer.setDataToReferTo(channels, NUM_CHANNELS, numFrames);       // no allocation for up to 31 channels (AudioBuffer's preallocated channel space)
+
+        const float gain = parameters[outputGain].load(std::memory_order_relaxed);
+
+        if (parameters[flangerEnabled].load(std::memory_order_relaxed) >= 0.5f)
+        {
+            flanger.setDepth(parameters[flangerDepth].load(std::memory_order_relaxed));
+            flanger.setFeedback(parameters[flangerFeedback].load(std::memory_order_relaxed));
+            flanger.setLFO(parameters[flangerRate].load(std::memory_order_relaxed));
+            const int maxDelay = rangeInSamples(parameters[flangerRange].load(std::memory_order_relaxed));
+
+            for (auto channel = 0; channel < NUM_CHANNELS; ++channel)
+                flanger.process(&buffer, 0, numFrames, maxDelay, channel, 1.0f);
+
+            flanger.adjustWritePositions(numFrames);
+        }
+
+        if (parameters[pitchEnabled].load(std::memory_order_relaxed) >= 0.5f)
+        {
+            pitchShifter.setLevel(parameters[pitchRate].load(std::memory_order_relaxed));
+
+            if (parameters[pitchUp].load(std::memory_order_relaxed) >= 0.5f)
+                pitchShifter.setUp();
+            else
+                pitchShifter.setDown();
+
+            const int maxDelay = rangeInSamples(parameters[pitchRange].load(std::memory_order_relaxed));
+
+            for (auto channel = 0; channel < NUM_CHANNELS; ++channel)
+                pitchShifter.process(&buffer, 0, numFrames, maxDelay, channel, 1.0f);
+
+            pitchShifter.adjustWritePositions(numFrames);
+        }
+
+        for (auto channel = 0; channel < NUM_CHANNELS; ++channel)
+            for (auto sample = 0; sample < numFrames; ++sample)
+                channels[channel][sample] *= gain;
+
+        governor.endCallback(numFrames, sampleRate);
+    }
+
+    int rangeInSamples(float milliseconds) const
+    {
+        return jmax(1, static_cast<int>(milliseconds * 0.001 * sampleRate));
+    }
+
+
+    jack_client_t* client{ nullptr };
+    jack_port_t* inputPorts[NUM_CHANNELS]{};
+    jack_port_t* outputPorts[NUM_CHANNELS]{};
+    double sampleRate{ 44100 };
+
+    Flanger flanger;
+    PitchShifter pitchShifter;
+    LoadGovernor governor;
+    DiagnosticLog diagnostics;          // anomalies found by the effects, printed to stderr by its own thread
+    AudioBuffer<float> buffer;
+    std::atomic<float> parameters[numParameters];
+
+};
+
+
+//************* Control socket: one "name value" pair per datagram, answered with "ok" or "error" *****************************//
+
+static void runControlSocket(JackEffectChain& chain, int port)
+{
+    const int socketHandle = socket(AF_INET, SOCK_DGRAM, 0);
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (socketHandle < 0 || bind(socketHandle, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+    {
+        std::fprintf(stderr, "could not bind control socket to 127.0.0.1:%d\n", port);
+        chain.shutdown.store(true);
+        return;
+    }
+
+    timeval timeout{ 0, 200000 };                   // wake up regularly to notice shutdown
+    setsockopt(socketHandle, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    while (! chain.shutdown.load())
+    {
+        char message[256];
+        sockaddr_in sender{};
+        socklen_t senderLength = sizeof(sender);
+        const ssize_t length = recvfrom(socketHandle, message, sizeof(message) - 1, 0, reinterpret_cast<sockaddr*>(&sender), &senderLength);
+
+        if (length <= 0)
+            continue;
+
+        message[length] = 0;
+        char name[64];
+        float value;
+        const bool accepted = std::sscanf(message, "%63s %f", name, &value) == 2 && chain.setParameter(name, value);
+
+        const char* reply = accepted ? "ok\n" : "error\n";
+        sendto(socketHandle, reply, std::strlen(reply), 0, reinterpret_cast<sockaddr*>(&sender), senderLength);
+    }
+
+    ::close(socketHandle);
+}
+
+
+static std::atomic<bool> interrupted{ false };
+
+static void handleSignal(int)
+{
+    interrupted.store(true);
+}
+
+int main(int argc, char** argv)
+{
+    const int controlPort = argc > 1 ? std::atoi(argv[1]) : DEFAULT_CONTROL_PORT;
+
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+        std::fprintf(stderr, "warning: mlockall failed, page faults may cause xruns\n");
+
+   #if JUCE_FX_ENABLE_TRACING
+    if (const char* tracePath = std::getenv("JUCE_FX_TRACE"))
+        if (! DspTrace::getInstance().start(tracePath))
+            std::fprintf(stderr, "warning: could not open trace file %s\n", tracePath);
+   #endif
+
+    JackEffectChain chain;
+
+    if (! chain.open("juce_fx"))
+        return 1;
+
+    std::signal(SIGINT, handleSignal);
+    std::signal(SIGTERM, handleSignal);
+
+    std::thread control([&] { runControlSocket(chain, controlPort); });
+    std::printf("juce_fx running, control socket on 127.0.0.1:%d\n", controlPort);
+
+    while (! interrupted.load() && ! chain.shutdown.load())
+        usleep(100000);
+
+    chain.shutdown.store(true);
+    control.join();
+    chain.close();
+
+   #if JUCE_FX_ENABLE_TRACING
+    DspTrace::getInstance().stop();
+   #endif
+
+    return 0;
+}
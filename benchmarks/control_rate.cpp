@@ -0,0 +1,120 @@
+/***************************************************************************************
+Benchmark of the control-rate modulation: renders ten seconds of stereo audio through the Flanger
+and the PitchShifter at control rates K = 1 ... 64 and prints, for every K, the processing time
+(best of several runs) and the largest difference to the output at K = 1 (audio-rate modulation).
+****************************************************************************************/
+
+#include "Flanger.h"
+#include "PitchShifter.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#define BENCHMARK_SAMPLE_RATE 44100.0
+#define BENCHMARK_SECONDS 10
+#define BENCHMARK_BLOCK_SIZE 512
+#define BENCHMARK_RUNS 5
+#define BENCHMARK_MAX_DELAY 300
+
+
+struct Result
+{
+	double seconds;
+	std::vector<float> output;
+};
+
+static void configure(Flanger& flanger)
+{
+	flanger.setDepth(0.7f);
+	flanger.setLFO(0.5f);
+	flanger.setFeedback(0.5f);
+}
+
+static void configure(PitchShifter& pitchShifter)
+{
+	pitchShifter.setLevel(8.0f);
+	pitchShifter.setUp();
+}
+
+
+//************* Renders the whole signal BENCHMARK_RUNS times with a fresh effect and keeps the fastest run *************************//
+
+template <typename Effect>
+static Result render(int controlRate, const AudioBuffer<float>& input)
+{
+	const int length = input.getNumSamples();
+	Result result{ 1.0e30, {} };
+	AudioBuffer<float> block(2, BENCHMARK_BLOCK_SIZE);
+
+	for (auto run = 0; run < BENCHMARK_RUNS; ++run)
+	{
+		Effect effect;
+		effect.initialize(BENCHMARK_BLOCK_SIZE, BENCHMARK_SAMPLE_RATE);
+		effect.setControlRate(controlRate);
+		configure(effect);
+
+		std::vector<float> output;
+		output.reserve(static_cast<size_t>(2 * length));
+		double seconds = 0.0;
+
+		for (auto position = 0; position < length; position += BENCHMARK_BLOCK_SIZE)
+		{
+			const int numSamples = jmin(BENCHMARK_BLOCK_SIZE, length - position);
+
+			for (auto channel = 0; channel < 2; ++channel)
+				block.copyFrom(channel, 0, input, channel, position, numSamples);
+
+			const auto start = std::chrono::steady_clock::now();
+
+			for (auto channel = 0; channel < 2; ++channel)
+				effect.process(&block, 0, numSamples, BENCHMARK_MAX_DELAY, channel, 1.0f);
+
+			effect.adjustWritePositions(numSamples);
+			seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			for (auto channel = 0; channel < 2; ++channel)
+				output.insert(output.end(), block.getReadPointer(channel), block.getReadPointer(channel) + numSamples);
+		}
+
+		if (seconds < result.seconds)
+			result = { seconds, std::move(output) };
+	}
+
+	return result;
+}
+
+template <typename Effect>
+static void benchmark(const char* name, const AudioBuffer<float>& input)
+{
+	const Result reference = render<Effect>(1, input);
+	std::printf("\n%s\n%6s %12s %10s %14s\n", name, "K", "time (ms)", "speedup", "max error");
+
+	for (const int controlRate : { 1, 2, 4, 8, 16, 32, 64 })
+	{
+		const Result result = controlRate == 1 ? reference : render<Effect>(controlRate, input);
+		float maxError = 0.0f;
+
+		for (size_t i = 0; i < result.output.size(); ++i)
+			maxError = jmax(maxError, std::abs(result.output[i] - reference.output[i]));
+
+		std::printf("%6d %12.2f %9.2fx %14.3g\n", controlRate, 1000.0 * result.seconds, reference.seconds / result.seconds, maxError);
+	}
+}
+
+
+int main()
+{
+	const int length = static_cast<int>(BENCHMARK_SECONDS * BENCHMARK_SAMPLE_RATE);
+	AudioBuffer<float> input(2, length);
+
+	for (auto channel = 0; channel < 2; ++channel)
+		for (auto i = 0; i < length; ++i)
+			input.setSample(channel, i, 0.5f * static_cast<float>(std::sin(0.01 * i * (channel + 1))) + 0.1f * static_cast<float>(std::sin(0.37 * i)));
+
+	std::printf("%d s of stereo audio at %g Hz in blocks of %d samples, best of %d runs", BENCHMARK_SECONDS, BENCHMARK_SAMPLE_RATE, BENCHMARK_BLOCK_SIZE, BENCHMARK_RUNS);
+	benchmark<Flanger>("Flanger", input);
+	benchmark<PitchShifter>("PitchShifter", input);
+	return 0;
+}
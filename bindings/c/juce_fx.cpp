@@ -0,0 +1,208 @@
+/***************************************************************************************
+Implementation of the libjuce_fx C interface. Build it as a shared library with JUCE_FX_BUILD defined.
+No C++ exception is allowed to cross the C boundary: failures are reported as juce_fx_status codes.
+****************************************************************************************/
+
+#include "juce_fx.h"
+
+#include <cmath>
+#include <new>
+
+#include "../../Flanger.h"
+#include "../../PitchShifter.h"
+
+
+struct juce_fx_effect
+{
+    juce_fx_type type;
+    Flanger flanger;
+    PitchShifter pitchShifter;
+
+    bool prepared{ false };
+    double sampleRate{ 0 };
+    int32_t maxBlockSize{ 0 }, numChannels{ 0 };
+
+    int maxDelayInSamples{ 0 };
+    float gain{ 1.0f };
+};
+
+
+//************* Runs one effect over the host's channel pointers, in blocks of at most the prepared block size ******************//
+
+template <typename Effect>
+static void processEffect(Effect& fx, juce_fx_effect* effect, float* const* channels, int32_t numChannels, int32_t numSamples)
+{
+    AudioBuffer<float> buffer(channels, numChannels, numSamples);           // refers to the host memory, no copy
+
+    for (auto blockStart = 0; blockStart < numSamples; blockStart += effect->maxBlockSize)
+    {
+        const int blockLength = jmin(effect->maxBlockSize, numSamples - blockStart);
+
+        for (auto channel = 0; channel < numChannels; ++channel)
+            fx.process(&buffer, blockStart, blockLength, effect->maxDelayInSamples, channel, effect->gain);
+
+        fx.adjustWritePositions(blockLength);
+    }
+}
+
+
+extern "C" {
+
+uint32_t juce_fx_version(void)
+{
+    return (JUCE_FX_VERSION_MAJOR << 16) | (JUCE_FX_VERSION_MINOR << 8) | JUCE_FX_VERSION_PATCH;
+}
+
+juce_fx_effect* juce_fx_create(juce_fx_type type)
+{
+    if (type != JUCE_FX_FLANGER && type != JUCE_FX_PITCH_SHIFTER)
+        return nullptr;
+
+    auto* effect = new (std::nothrow) juce_fx_effect();
+
+    if (effect != nullptr)
+        effect->type = type;
+
+    return effect;
+}
+
+juce_fx_status juce_fx_prepare(juce_fx_effect* effect, double sample_rate, int32_t max_block_size, int32_t num_channels)
+{
+    if (effect == nullptr || ! (sample_rate > 0 && sample_rate <= JUCE_FX_MAX_SAMPLE_RATE) || max_block_size <= 0 || num_channels <= 0)
+        return JUCE_FX_ERROR_INVALID_ARGUMENT;
+
+    try
+    {
+        if (effect->type == JUCE_FX_FLANGER)
+            effect->flanger.initialize(max_block_size, sample_rate, num_channels);
+        else
+            effect->pitchShifter.initialize(max_block_size, sample_rate, num_channels);
+    }
+    catch (const std::bad_alloc&)
+    {
+        effect->prepared = false;
+        return JUCE_FX_ERROR_OUT_OF_MEMORY;
+    }
+
+    effect->prepared = true;
+    effect->sampleRate = sample_rate;
+    effect->maxBlockSize = max_block_size;
+    effect->numChannels = num_channels;
+    effect->maxDelayInSamples = static_cast<int>(TP_RANGE * sample_rate) / 2;
+    return JUCE_FX_OK;
+}
+
+juce_fx_status juce_fx_process(juce_fx_effect* effect, float* const* channels, int32_t num_channels, int32_t num_samples)
+{
+    if (effect == nullptr || channels == nullptr || num_channels < 0 || num_samples < 0)
+        return JUCE_FX_ERROR_INVALID_ARGUMENT;
+
+    if (! effect->prepared)
+        return JUCE_FX_ERROR_NOT_PREPARED;
+
+    if (num_channels > effect->numChannels)
+        return JUCE_FX_ERROR_INVALID_ARGUMENT;
+
+    if (effect->type == JUCE_FX_FLANGER)
+        processEffect(effect->flanger, effect, channels, num_channels, num_samples);
+    else
+        processEffect(effect->pitchShifter, effect, channels, num_channels, num_samples);
+
+    return JUCE_FX_OK;
+}
+
+juce_fx_status juce_fx_set_param(juce_fx_effect* effect, juce_fx_param param, double value)
+{
+    if (effect == nullptr)
+        return JUCE_FX_ERROR_INVALID_ARGUMENT;
+
+    /* NaN and infinities would slip through the range checks below (every comparison with NaN is false) and reach the
+       float to int casts or the feedback loop, so they are rejected for every parameter. The range checks are written so
+       that NaN fails them as well. */
+    if (! std::isfinite(value))
+        return JUCE_FX_ERROR_INVALID_ARGUMENT;
+
+    const bool isFlanger = effect->type == JUCE_FX_FLANGER;
+
+    switch (param)
+    {
+        case JUCE_FX_PARAM_GAIN:
+            effect->gain = static_cast<float>(value);
+            return JUCE_FX_OK;
+
+        case JUCE_FX_PARAM_MAX_DELAY_SAMPLES:
+            if (! effect->prepared)
+                return JUCE_FX_ERROR_NOT_PREPARED;
+            if (! (value >= 1 && value < static_cast<int>(TP_RANGE * effect->sampleRate)))
+                return JUCE_FX_ERROR_INVALID_ARGUMENT;
+            effect->maxDelayInSamples = static_cast<int>(value);
+            return JUCE_FX_OK;
+
+        case JUCE_FX_PARAM_CONTROL_RATE:
+            if (! (value >= 1 && value <= JUCE_FX_MAX_CONTROL_RATE))
+                return JUCE_FX_ERROR_INVALID_ARGUMENT;
+            if (isFlanger)
+                effect->flanger.setControlRate(static_cast<int>(value));
+            else
+                effect->pitchShifter.setControlRate(static_cast<int>(value));
+            return JUCE_FX_OK;
+
+        case JUCE_FX_PARAM_RATE:
+            if (! effect->prepared)
+                return JUCE_FX_ERROR_NOT_PREPARED;
+            if (! (value >= 0 && value < effect->sampleRate / 2 && (isFlanger || value < effect->pitchShifter.getMaxLevel())))
+                return JUCE_FX_ERROR_INVALID_ARGUMENT;
+            if (isFlanger)
+                effect->flanger.setLFO(static_cast<float>(value));
+            else
+                effect->pitchShifter.setLevel(static_cast<float>(value));
+            return JUCE_FX_OK;
+
+        case JUCE_FX_PARAM_DEPTH:
+            if (! isFlanger)
+                return JUCE_FX_ERROR_INVALID_ARGUMENT;
+            effect->flanger.setDepth(static_cast<float>(value));
+            return JUCE_FX_OK;
+
+        case JUCE_FX_PARAM_FEEDBACK:
+            if (! isFlanger || ! (value > -1.0 && value < 1.0))
+                return JUCE_FX_ERROR_INVALID_ARGUMENT;
+            effect->flanger.setFeedback(static_cast<float>(value));
+            return JUCE_FX_OK;
+
+        case JUCE_FX_PARAM_PITCH_UP:
+            if (isFlanger)
+                return JUCE_FX_ERROR_INVALID_ARGUMENT;
+            if (value != 0)
+                effect->pitchShifter.setUp();
+            else
+                effect->pitchShifter.setDown();
+            return JUCE_FX_OK;
+
+        default:
+            return JUCE_FX_ERROR_INVALID_ARGUMENT;
+    }
+}
+
+juce_fx_status juce_fx_reset(juce_fx_effect* effect)
+{
+    if (effect == nullptr)
+        return JUCE_FX_ERROR_INVALID_ARGUMENT;
+
+    if (! effect->prepared)
+        return JUCE_FX_ERROR_NOT_PREPARED;
+
+    if (effect->type == JUCE_FX_FLANGER)
+        effect->flanger.reset();
+    else
+        effect->pitchShifter.reset();
+
+    return JUCE_FX_OK;
+}
+
+void juce_fx_destroy(juce_fx_effect* effect)
+{
+    delete effect;
+}
+
+}
@@ -0,0 +1,81 @@
+/***************************************************************************************
+Stable C interface of libjuce_fx, exposing the Flanger and PitchShifter effects to non-C++ hosts
+(Rust, Go, ...). Effects are opaque handles and process non-interleaved float buffers in place.
+****************************************************************************************/
+
+#ifndef JUCE_FX_H
+#define JUCE_FX_H
+
+#include <stdint.h>
+
+#if defined (_WIN32)
+ #if defined (JUCE_FX_BUILD)
+  #define JUCE_FX_API __declspec(dllexport)
+ #else
+  #define JUCE_FX_API __declspec(dllimport)
+ #endif
+#else
+ #define JUCE_FX_API __attribute__((visibility("default")))
+#endif
+
+#include "../../Version.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Plain integer types instead of enums, so the ABI does not depend on the compiler's enum size. */
+
+typedef int32_t juce_fx_type;
+#define JUCE_FX_FLANGER                   0
+#define JUCE_FX_PITCH_SHIFTER             1
+
+typedef int32_t juce_fx_status;
+#define JUCE_FX_OK                        0
+#define JUCE_FX_ERROR_INVALID_ARGUMENT   -1
+#define JUCE_FX_ERROR_NOT_PREPARED       -2
+#define JUCE_FX_ERROR_OUT_OF_MEMORY      -3
+
+typedef int32_t juce_fx_param;
+#define JUCE_FX_PARAM_GAIN                0    /* output gain, both effects (default 1) */
+#define JUCE_FX_PARAM_MAX_DELAY_SAMPLES   1    /* modulation range in samples, below 10 ms (default 5 ms) */
+#define JUCE_FX_PARAM_CONTROL_RATE        2    /* modulator evaluated every N samples, 1 to JUCE_FX_MAX_CONTROL_RATE (default 1) */
+#define JUCE_FX_PARAM_DEPTH               3    /* flanger only */
+#define JUCE_FX_PARAM_FEEDBACK            4    /* flanger only, must stay below 1 */
+#define JUCE_FX_PARAM_RATE                5    /* flanger LFO or pitch shifter sawtooth frequency in Hz, 0 to below half the sample rate */
+#define JUCE_FX_PARAM_PITCH_UP            6    /* pitch shifter only, nonzero = up, zero = down */
+
+#define JUCE_FX_MAX_CONTROL_RATE          4096
+#define JUCE_FX_MAX_SAMPLE_RATE           1536000.0
+
+typedef struct juce_fx_effect juce_fx_effect;
+
+/* (major << 16) | (minor << 8) | patch of the loaded library */
+JUCE_FX_API uint32_t juce_fx_version(void);
+
+/* Returns NULL for an unknown type or when out of memory. */
+JUCE_FX_API juce_fx_effect* juce_fx_create(juce_fx_type type);
+
+/* Allocates the delay lines. Not realtime safe. May be called again to change the configuration. sample_rate must be above
+   0 and at most JUCE_FX_MAX_SAMPLE_RATE. */
+JUCE_FX_API juce_fx_status juce_fx_prepare(juce_fx_effect* effect, double sample_rate, int32_t max_block_size, int32_t num_channels);
+
+/* Processes num_channels buffers of num_samples floats in place. Realtime safe, no allocation. Blocks longer
+   than max_block_size are split internally. */
+JUCE_FX_API juce_fx_status juce_fx_process(juce_fx_effect* effect, float* const* channels, int32_t num_channels, int32_t num_samples);
+
+/* Sets one of the JUCE_FX_PARAM_* values. Must not run concurrently with juce_fx_process on the same effect. NaN, infinite
+   and out of range values return JUCE_FX_ERROR_INVALID_ARGUMENT and leave the effect unchanged. */
+JUCE_FX_API juce_fx_status juce_fx_set_param(juce_fx_effect* effect, juce_fx_param param, double value);
+
+/* Clears the delay lines and restarts the modulators. */
+JUCE_FX_API juce_fx_status juce_fx_reset(juce_fx_effect* effect);
+
+/* Accepts NULL. */
+JUCE_FX_API void juce_fx_destroy(juce_fx_effect* effect);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,170 @@
+/***************************************************************************************
+Python bindings (pybind11) for the Flanger and PitchShifter effects. NumPy float32 arrays are
+processed in place, and the GIL is released while the DSP runs, so several clips can be processed
+in parallel from Python threads (one effect instance per thread).
+****************************************************************************************/
+
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+#include "../../Flanger.h"
+#include "../../PitchShifter.h"
+
+namespace py = pybind11;
+
+#define MAX_PYTHON_CHANNELS 31          // AudioBuffer refers to up to 31 channels without allocating, like MAX_FARM_CHANNELS
+
+
+//************* Owns one effect together with the settings it was initialized with. Arrays longer than the block size **********//
+//************* given at construction are processed in consecutive blocks, like a host would deliver them. *********************//
+
+template <typename Effect>
+class PythonEffect {
+
+public:
+
+    PythonEffect(double sampleRate, int maxBlockSize, int numChannels)
+        : sampleRate(sampleRate), maxBlockSize(maxBlockSize), numChannels(numChannels)
+    {
+        if (sampleRate <= 0 || maxBlockSize <= 0)
+            throw std::invalid_argument("sample_rate and max_block_size must be positive");
+
+        if (numChannels < 1 || numChannels > MAX_PYTHON_CHANNELS)
+            throw std::invalid_argument("channels must be between 1 and " + std::to_string(MAX_PYTHON_CHANNELS));
+
+        effect.initialize(maxBlockSize, sampleRate, numChannels);
+    }
+
+
+    //************ Processes a (samples,) or (channels, samples) C-contiguous float32 array in place. ******************************//
+
+    void process(py::array_t<float, py::array::c_style> audio, int maxDelayInSamples, float gain)
+    {
+        checkMaxDelay(maxDelayInSamples);
+
+        if (audio.ndim() != 1 && audio.ndim() != 2)
+            throw std::invalid_argument("expected a 1-D (samples,) or 2-D (channels, samples) array");
+
+        const int channels = audio.ndim() == 1 ? 1 : static_cast<int>(audio.shape(0));
+        const int numSamples = static_cast<int>(audio.shape(audio.ndim() - 1));
+
+        if (channels > numChannels)
+            throw std::invalid_argument("array has more channels than the effect was created with");
+
+        float* data = audio.mutable_data();
+        float* channelPointers[MAX_PYTHON_CHANNELS];
+
+        for (auto channel = 0; channel < channels; ++channel)
+            channelPointers[channel] = data + static_cast<size_t>(channel) * numSamples;
+
+        py::gil_scoped_release release;
+        processChannels(channelPointers, channels, numSamples, maxDelayInSamples, gain);
+    }
+
+
+    //************ Processes a (clips, samples) array in place, treating every row as an independent mono clip. The effect is *****//
+    //************ reset before each clip, so the result does not depend on the order of the clips. ********************************//
+
+    void processBatch(py::array_t<float, py::array::c_style> clips, int maxDelayInSamples, float gain)
+    {
+        checkMaxDelay(maxDelayInSamples);
+
+        if (clips.ndim() != 2)
+            throw std::invalid_argument("expected a 2-D (clips, samples) array");
+
+        const auto numClips = clips.shape(0);
+        const int numSamples = static_cast<int>(clips.shape(1));
+        float* data = clips.mutable_data();
+
+        py::gil_scoped_release release;
+
+        for (py::ssize_t clip = 0; clip < numClips; ++clip)
+        {
+            float* channelPointers[1] = { data + static_cast<size_t>(clip) * numSamples };
+
+            effect.reset();
+            processChannels(channelPointers, 1, numSamples, maxDelayInSamples, gain);
+        }
+
+        effect.reset();
+    }
+
+
+    //************ Rates (flanger LFO or pitch shifter sawtooth, in Hz) must lie in [0, limit), limit at most half the sample *****//
+    //************ rate. The comparison is written so that NaN fails it too. *******************************************************//
+
+    void checkRate(float rate, double limit) const
+    {
+        limit = jmin(limit, sampleRate / 2);
+
+        if (! (rate >= 0 && rate < limit))
+            throw std::invalid_argument("rate must lie in [0, " + std::to_string(limit) + ")");
+    }
+
+
+    Effect effect;
+
+private:
+
+    void processChannels(float* const* channelPointers, int channels, int numSamples, int maxDelayInSamples, float gain)
+    {
+        AudioBuffer<float> buffer(channelPointers, channels, numSamples);       // refers to the NumPy memory, no copy
+
+        for (auto blockStart = 0; blockStart < numSamples; blockStart += maxBlockSize)
+        {
+            const int blockLength = jmin(maxBlockSize, numSamples - blockStart);
+
+            for (auto channel = 0; channel < channels; ++channel)
+                effect.process(&buffer, blockStart, blockLength, maxDelayInSamples, channel, gain);
+
+            effect.adjustWritePositions(blockLength);
+        }
+    }
+
+    void checkMaxDelay(int maxDelayInSamples) const
+    {
+        if (maxDelayInSamples < 1 || maxDelayInSamples >= static_cast<int>(TP_RANGE * sampleRate))
+            throw std::invalid_argument("max_delay_samples must lie in [1, " + std::to_string(static_cast<int>(TP_RANGE * sampleRate)) + ")");
+    }
+
+    double sampleRate;
+    int maxBlockSize, numChannels;
+
+};
+
+
+using PythonFlanger = PythonEffect<Flanger>;
+using PythonPitchShifter = PythonEffect<PitchShifter>;
+
+
+PYBIND11_MODULE(juce_fx, m)
+{
+    m.doc() = "Flanger and PitchShifter audio effects operating in place on NumPy float32 arrays";
+
+    py::class_<PythonFlanger>(m, "Flanger")
+        .def(py::init<double, int, int>(), py::arg("sample_rate"), py::arg("max_block_size") = 4096, py::arg("channels") = 2)
+        .def("process", &PythonFlanger::process, py::arg("audio").noconvert(), py::arg("max_delay_samples"), py::arg("gain") = 1.0f,
+             "Processes a (samples,) or (channels, samples) float32 array in place. The GIL is released meanwhile.")
+        .def("process_batch", &PythonFlanger::processBatch, py::arg("clips").noconvert(), py::arg("max_delay_samples"), py::arg("gain") = 1.0f,
+             "Processes every row of a (clips, samples) float32 array in place as an independent mono clip.")
+        .def("reset", [](PythonFlanger& self) { self.effect.reset(); })
+        .def("set_depth", [](PythonFlanger& self, float depth) { self.effect.setDepth(depth); })
+        .def("set_feedback", [](PythonFlanger& self, float feedback) { self.effect.setFeedback(feedback); })
+        .def("set_lfo", [](PythonFlanger& self, float rate) { self.checkRate(rate, std::numeric_limits<double>::infinity()); self.effect.setLFO(rate); })
+        .def("set_control_rate", [](PythonFlanger& self, int samples) { self.effect.setControlRate(samples); });
+
+    py::class_<PythonPitchShifter>(m, "PitchShifter")
+        .def(py::init<double, int, int>(), py::arg("sample_rate"), py::arg("max_block_size") = 4096, py::arg("channels") = 2)
+        .def("process", &PythonPitchShifter::process, py::arg("audio").noconvert(), py::arg("max_delay_samples"), py::arg("gain") = 1.0f,
+             "Processes a (samples,) or (channels, samples) float32 array in place. The GIL is released meanwhile.")
+        .def("process_batch", &PythonPitchShifter::processBatch, py::arg("clips").noconvert(), py::arg("max_delay_samples"), py::arg("gain") = 1.0f,
+             "Processes every row of a (clips, samples) float32 array in place as an independent mono clip.")
+        .def("reset", [](PythonPitchShifter& self) { self.effect.reset(); })
+        .def("set_up", [](PythonPitchShifter& self) { self.effect.setUp(); })
+        .def("set_down", [](PythonPitchShifter& self) { self.effect.setDown(); })
+        .def("set_level", [](PythonPitchShifter& self, float rate) { self.checkRate(rate, self.effect.getMaxLevel()); self.effect.setLevel(rate); })
+        .def("set_control_rate", [](PythonPitchShifter& self, int samples) { self.effect.setControlRate(samples); });
+}
@@ -0,0 +1,463 @@
+/***************************************************************************************
+CLAP plugin build of the Flanger and PitchShifter effects. Both plugins are exported from one binary.
+When the host offers the thread-pool extension, the channels of each block are processed as separate
+tasks on the host's threads, which maps directly onto the per-channel process() callbacks. Each task
+gets its own view of the output, and the effects reach their delay rings through raw channel pointers
+(see DelayRing.h), so concurrent tasks never write to a shared AudioBuffer object.
+****************************************************************************************/
+
+#include <clap/clap.h>
+
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "../../Flanger.h"
+#include "../../PitchShifter.h"
+
+#define CLAP_MAX_CHANNELS 2
+
+
+//************* Parameter tables. Modulation range is exposed in milliseconds and converted to samples on activation. **********//
+
+struct ParameterInfo
+{
+    clap_id id;
+    const char* name;
+    double minValue, maxValue, defaultValue;
+    bool stepped;
+};
+
+enum FlangerParameter : clap_id { flangerDepth, flangerFeedback, flangerRate, flangerRange, flangerGain, numFlangerParameters };
+enum PitchShifterParameter : clap_id { pitchRate, pitchUp, pitchRange, pitchGain, numPitchShifterParameters };
+
+static const ParameterInfo flangerParameters[numFlangerParameters] =
+{
+    { flangerDepth,     "Depth",                0.0,  1.0,  0.7, false },
+    { flangerFeedback,  "Feedback",             0.0,  0.95, 0.0, false },
+    { flangerRate,      "Rate (Hz)",            0.05, 10.0, 0.5, false },
+    { flangerRange,     "Modulation range (ms)",0.1,  9.5,  5.0, false },
+    { flangerGain,      "Output gain",          0.0,  2.0,  1.0, false }
+};
+
+static const ParameterInfo pitchShifterParameters[numPitchShifterParameters] =
+{
+    { pitchRate,        "Rate (Hz)",            0.0,  50.0, 5.0, false },
+    { pitchUp,          "Pitch up",             0.0,  1.0,  1.0, true  },
+    { pitchRange,       "Modulation range (ms)",0.1,  9.5,  5.0, false },
+    { pitchGain,        "Output gain",          0.0,  2.0,  1.0, false }
+};
+
+
+//************* Per-effect glue: descriptor, parameter table and how a parameter value reaches the DSP object ******************//
+
+template <typename Effect> struct EffectTraits;
+
+template <> struct EffectTraits<Flanger>
+{
+    static constexpr const char* id = "com.juce-audio-effects.flanger";
+    static constexpr const char* name = "Flanger";
+    static constexpr const char* description = "Flanger with optional feedback";
+    static constexpr const ParameterInfo* parameters = flangerParameters;
+    static constexpr uint32_t numParameters = numFlangerParameters;
+    static constexpr clap_id rangeParameter = flangerRange;
+    static constexpr clap_id gainParameter = flangerGain;
+
+    static void apply(Flanger& flanger, clap_id id, double value)
+    {
+        switch (id)
+        {
+            case flangerDepth:      flanger.setDepth(static_cast<float>(value)); break;
+            case flangerFeedback:   flanger.setFeedback(static_cast<float>(value)); break;
+            case flangerRate:       flanger.setLFO(static_cast<float>(value)); break;
+            default: break;
+        }
+    }
+};
+
+template <> struct EffectTraits<PitchShifter>
+{
+    static constexpr const char* id = "com.juce-audio-effects.pitch-shifter";
+    static constexpr const char* name = "Pitch Shifter";
+    static constexpr const char* description = "Doppler based pitch shifter";
+    static constexpr const ParameterInfo* parameters = pitchShifterParameters;
+    static constexpr uint32_t numParameters = numPitchShifterParameters;
+    static constexpr clap_id rangeParameter = pitchRange;
+    static constexpr clap_id gainParameter = pitchGain;
+
+    static void apply(PitchShifter& pitchShifter, clap_id id, double value)
+    {
+        switch (id)
+        {
+            case pitchRate:         pitchShifter.setLevel(static_cast<float>(value)); break;
+            case pitchUp:           if (value >= 0.5) pitchShifter.setUp(); else pitchShifter.setDown(); break;
+            default: break;
+        }
+    }
+};
+
+static const char* const pluginFeatures[] = { CLAP_PLUGIN_FEATURE_AUDIO_EFFECT, CLAP_PLUGIN_FEATURE_STEREO, nullptr };
+
+template <typename Effect>
+static const clap_plugin_descriptor_t* getDescriptor()
+{
+    static const clap_plugin_descriptor_t descriptor =
+    {
+        CLAP_VERSION_INIT,
+        EffectTraits<Effect>::id,
+        EffectTraits<Effect>::name,
+        "JUCE audio effects",
+        "https://github.com/stijn-reniers/JUCE-audio-effects",
+        "",
+        "",
+        "1.0.0",
+        EffectTraits<Effect>::description,
+        pluginFeatures
+    };
+
+    return &descriptor;
+}
+
+
+//************* One plugin instance. The clap_plugin_t vtable forwards to the static functions below. *************************//
+
+template <typename Effect>
+class ClapEffectPlugin {
+
+public:
+
+    using Traits = EffectTraits<Effect>;
+
+    ClapEffectPlugin(const clap_host_t* host) : host(host)
+    {
+        plugin.desc = getDescriptor<Effect>();
+        plugin.plugin_data = this;
+        plugin.init = init;
+        plugin.destroy = destroy;
+        plugin.activate = activate;
+        plugin.deactivate = deactivate;
+        plugin.start_processing = startProcessing;
+        plugin.stop_processing = stopProcessing;
+        plugin.reset = reset;
+        plugin.process = process;
+        plugin.get_extension = getExtension;
+        plugin.on_main_thread = onMainThread;
+
+        for (uint32_t i = 0; i < Traits::numParameters; ++i)
+            values[i].store(Traits::parameters[i].defaultValue);
+    }
+
+    clap_plugin_t plugin{};
+
+private:
+
+    static ClapEffectPlugin& self(const clap_plugin_t* plugin)
+    {
+        return *static_cast<ClapEffectPlugin*>(plugin->plugin_data);
+    }
+
+    static bool init(const clap_plugin_t* plugin)
+    {
+        auto& p = self(plugin);
+        p.hostThreadPool = static_cast<const clap_host_thread_pool_t*>(p.host->get_extension(p.host, CLAP_EXT_THREAD_POOL));
+        return true;
+    }
+
+    static void destroy(const clap_plugin_t* plugin)
+    {
+        delete &self(plugin);
+    }
+
+    static bool activate(const clap_plugin_t* plugin, double sampleRate, uint32_t, uint32_t maxFramesCount)
+    {
+        auto& p = self(plugin);
+        p.sampleRate = sampleRate;
+        p.effect.initialize(static_cast<int>(maxFramesCount), sampleRate, CLAP_MAX_CHANNELS);
+
+        for (uint32_t i = 0; i < Traits::numParameters; ++i)
+            p.applyParameter(Traits::parameters[i].id, p.values[i].load());
+
+        return true;
+    }
+
+    static void deactivate(const clap_plugin_t*) {}
+    static bool startProcessing(const clap_plugin_t*) { return true; }
+    static void stopProcessing(const clap_plugin_t*) {}
+    static void onMainThread(const clap_plugin_t*) {}
+
+    static void reset(const clap_plugin_t* plugin)
+    {
+        self(plugin).effect.reset();
+    }
+
+
+    //************ Parameter events split the block, so automation is sample accurate. Every segment is handed to the host ********//
+    //************ thread pool as one task per channel; if the host has no pool or declines, the channels run on this thread. ****//
+
+    static clap_process_status process(const clap_plugin_t* plugin, const clap_process_t* process)
+    {
+        auto& p = self(plugin);
+
+        if (process->audio_inputs_count < 1 || process->audio_outputs_count < 1)
+            return CLAP_PROCESS_CONTINUE;
+
+        const auto& input = process->audio_inputs[0];
+        const auto& output = process->audio_outputs[0];
+        const int numChannels = static_cast<int>(jmin(output.channel_count, static_cast<uint32_t>(CLAP_MAX_CHANNELS)));
+        const int numInputs = static_cast<int>(input.channel_count);
+        const int numSamples = static_cast<int>(process->frames_count);
+
+        // every output channel is processed: a mono input feeds all of them, without any input the effect rings out on silence
+        for (auto channel = 0; channel < numChannels; ++channel)
+        {
+            if (numInputs == 0)
+                std::memset(output.data32[channel], 0, sizeof(float) * static_cast<size_t>(numSamples));
+            else if (output.data32[channel] != input.data32[jmin(channel, numInputs - 1)])
+                std::memcpy(output.data32[channel], input.data32[jmin(channel, numInputs - 1)], sizeof(float) * static_cast<size_t>(numSamples));
+        }
+
+        for (auto channel = 0; channel < numChannels; ++channel)
+            p.channelBuffers[channel].setDataToReferTo(output.data32, numChannels, numSamples);
+
+        process->audio_outputs[0].constant_mask = 0;
+
+        const uint32_t numEvents = process->in_events->size(process->in_events);
+        uint32_t nextEvent = 0;
+        int segmentStart = 0;
+
+        while (segmentStart < numSamples)
+        {
+            while (nextEvent < numEvents)
+            {
+                const auto* header = process->in_events->get(process->in_events, nextEvent);
+
+                if (static_cast<int>(header->time) > segmentStart)
+                    break;
+
+                p.handleEvent(header);
+                ++nextEvent;
+            }
+
+            int segmentEnd = numSamples;
+
+            if (nextEvent < numEvents)
+                segmentEnd = jmin(numSamples, static_cast<int>(process->in_events->get(process->in_events, nextEvent)->time));
+
+            p.processSegment(segmentStart, segmentEnd - segmentStart, numChannels);
+            segmentStart = segmentEnd;
+        }
+
+        for (; nextEvent < numEvents; ++nextEvent)
+            p.handleEvent(process->in_events->get(process->in_events, nextEvent));
+
+        return CLAP_PROCESS_CONTINUE;
+    }
+
+    void processSegment(int startSample, int numSamples, int numChannels)
+    {
+        segmentStart = startSample;
+        segmentLength = numSamples;
+
+        if (numChannels < 2 || hostThreadPool == nullptr || ! hostThreadPool->request_exec(host, static_cast<uint32_t>(numChannels)))
+            for (auto channel = 0; channel < numChannels; ++channel)
+                processChannel(channel);
+
+        effect.adjustWritePositions(numSamples);
+    }
+
+    void processChannel(int channel)
+    {
+        effect.process(&channelBuffers[channel], segmentStart, segmentLength, maxDelayInSamples, channel, gain);
+    }
+
+    static void exec(const clap_plugin_t* plugin, uint32_t taskIndex)
+    {
+        self(plugin).processChannel(static_cast<int>(taskIndex));
+    }
+
+
+    void handleEvent(const clap_event_header_t* header)
+    {
+        if (header->space_id != CLAP_CORE_EVENT_SPACE_ID || header->type != CLAP_EVENT_PARAM_VALUE)
+            return;
+
+        const auto* event = reinterpret_cast<const clap_event_param_value_t*>(header);
+
+        if (event->param_id >= Traits::numParameters || ! std::isfinite(event->value))     // jlimit lets NaN through
+            return;
+
+        const auto& info = Traits::parameters[event->param_id];
+        const double value = jlimit(info.minValue, info.maxValue, event->value);
+
+        values[event->param_id].store(value);
+        applyParameter(event->param_id, value);
+    }
+
+    void applyParameter(clap_id id, double value)
+    {
+        if (id == Traits::rangeParameter)
+            maxDelayInSamples = jmax(1, static_cast<int>(value * 0.001 * sampleRate));
+        else if (id == Traits::gainParameter)
+            gain = static_cast<float>(value);
+        else
+            Traits::apply(effect, id, value);
+    }
+
+
+    //************ Extensions: one stereo in/out port pair, parameters and the thread-pool task callback ************************//
+
+    static const void* getExtension(const clap_plugin_t*, const char* id)
+    {
+        static const clap_plugin_audio_ports_t audioPorts = { audioPortsCount, audioPortsGet };
+        static const clap_plugin_params_t params = { paramsCount, paramsGetInfo, paramsGetValue, paramsValueToText, paramsTextToValue, paramsFlush };
+        static const clap_plugin_thread_pool_t threadPool = { exec };
+
+        if (std::strcmp(id, CLAP_EXT_AUDIO_PORTS) == 0)  return &audioPorts;
+        if (std::strcmp(id, CLAP_EXT_PARAMS) == 0)       return &params;
+        if (std::strcmp(id, CLAP_EXT_THREAD_POOL) == 0)  return &threadPool;
+        return nullptr;
+    }
+
+    static uint32_t audioPortsCount(const clap_plugin_t*, bool)
+    {
+        return 1;
+    }
+
+    static bool audioPortsGet(const clap_plugin_t*, uint32_t index, bool isInput, clap_audio_port_info_t* info)
+    {
+        if (index != 0)
+            return false;
+
+        info->id = 0;
+        std::snprintf(info->name, sizeof(info->name), "%s", isInput ? "Input" : "Output");
+        info->flags = CLAP_AUDIO_PORT_IS_MAIN;
+        info->channel_count = CLAP_MAX_CHANNELS;
+        info->port_type = CLAP_PORT_STEREO;
+        info->in_place_pair = 0;
+        return true;
+    }
+
+    static uint32_t paramsCount(const clap_plugin_t*)
+    {
+        return Traits::numParameters;
+    }
+
+    static bool paramsGetInfo(const clap_plugin_t*, uint32_t index, clap_param_info_t* info)
+    {
+        if (index >= Traits::numParameters)
+            return false;
+
+        const auto& parameter = Traits::parameters[index];
+        std::memset(info, 0, sizeof(*info));
+        info->id = parameter.id;
+        info->flags = CLAP_PARAM_IS_AUTOMATABLE | (parameter.stepped ? CLAP_PARAM_IS_STEPPED : 0);
+        std::snprintf(info->name, sizeof(info->name), "%s", parameter.name);
+        info->min_value = parameter.minValue;
+        info->max_value = parameter.maxValue;
+        info->default_value = parameter.defaultValue;
+        return true;
+    }
+
+    static bool paramsGetValue(const clap_plugin_t* plugin, clap_id id, double* value)
+    {
+        if (id >= Traits::numParameters)
+            return false;
+
+        *value = self(plugin).values[id].load();
+        return true;
+    }
+
+    static bool paramsValueToText(const clap_plugin_t*, clap_id id, double value, char* text, uint32_t size)
+    {
+        if (id >= Traits::numParameters)
+            return false;
+
+        if (Traits::parameters[id].stepped)
+            std::snprintf(text, size, "%s", value >= 0.5 ? "On" : "Off");
+        else
+            std::snprintf(text, size, "%.3f", value);
+
+        return true;
+    }
+
+    static bool paramsTextToValue(const clap_plugin_t*, clap_id id, const char* text, double* value)
+    {
+        if (id >= Traits::numParameters)
+            return false;
+
+        if (Traits::parameters[id].stepped && (std::strcmp(text, "On") == 0 || std::strcmp(text, "Off") == 0))
+        {
+            *value = std::strcmp(text, "On") == 0 ? 1.0 : 0.0;
+            return true;
+        }
+
+        char* end = nullptr;
+        *value = std::strtod(text, &end);
+        return end != text && std::isfinite(*value);          // strtod also parses "nan" and "inf"
+    }
+
+    static void paramsFlush(const clap_plugin_t* plugin, const clap_input_events_t* in, const clap_output_events_t*)
+    {
+        auto& p = self(plugin);
+
+        for (uint32_t i = 0; i < in->size(in); ++i)
+            p.handleEvent(in->get(in, i));
+    }
+
+
+    const clap_host_t* host;
+    const clap_host_thread_pool_t* hostThreadPool{ nullptr };
+
+    Effect effect;
+    AudioBuffer<float> channelBuffers[CLAP_MAX_CHANNELS];      // one view of the host's output per task, so tasks share no buffer object
+    int segmentStart{ 0 }, segmentLength{ 0 };                 // the part of the block the thread-pool tasks work on
+
+    std::atomic<double> values[Traits::numParameters];
+    double sampleRate{ 44100 };
+    int maxDelayInSamples{ 1 };
+    float gain{ 1.0f };
+
+};
+
+
+//************* Factory and entry point *************************************************************************************//
+
+static uint32_t factoryGetPluginCount(const clap_plugin_factory_t*)
+{
+    return 2;
+}
+
+static const clap_plugin_descriptor_t* factoryGetPluginDescriptor(const clap_plugin_factory_t*, uint32_t index)
+{
+    if (index == 0) return getDescriptor<Flanger>();
+    if (index == 1) return getDescriptor<PitchShifter>();
+    return nullptr;
+}
+
+static const clap_plugin_t* factoryCreatePlugin(const clap_plugin_factory_t*, const clap_host_t* host, const char* pluginId)
+{
+    if (! clap_version_is_compatible(host->clap_version))
+        return nullptr;
+
+    if (std::strcmp(pluginId, EffectTraits<Flanger>::id) == 0)
+        return &(new ClapEffectPlugin<Flanger>(host))->plugin;
+
+    if (std::strcmp(pluginId, EffectTraits<PitchShifter>::id) == 0)
+        return &(new ClapEffectPlugin<PitchShifter>(host))->plugin;
+
+    return nullptr;
+}
+
+static const clap_plugin_factory_t pluginFactory = { factoryGetPluginCount, factoryGetPluginDescriptor, factoryCreatePlugin };
+
+static bool entryInit(const char*) { return true; }
+static void entryDeinit() {}
+
+static const void* entryGetFactory(const char* factoryId)
+{
+    return std::strcmp(factoryId, CLAP_PLUGIN_FACTORY_ID) == 0 ? &pluginFactory : nullptr;
+}
+
+extern "C" CLAP_EXPORT const clap_plugin_entry_t clap_entry = { CLAP_VERSION_INIT, entryInit, entryDeinit, entryGetFactory };
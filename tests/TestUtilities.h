@@ -0,0 +1,94 @@
+/***************************************************************************************
+Shared helpers for the test executables: a reproducible test signal and a check macro that
+reports the failing expression and keeps going, so one run lists every failure.
+****************************************************************************************/
+
+#pragma once
+#include <JuceHeader.h>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+static int testFailures = 0;
+
+#define EXPECT(condition) \
+	do { if (! (condition)) { std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); ++testFailures; } } while (false)
+
+
+//************* Two sines per channel, different on every channel. Depends only on the absolute sample position, so any split *****//
+//************* of the stream into blocks sees the same input. ************************************************************************//
+
+inline float testSignal(int channel, int64 sample)
+{
+	return 0.5f * static_cast<float>(std::sin(0.01 * static_cast<double>(sample) * (channel + 1)))
+		 + 0.1f * static_cast<float>(std::sin(0.37 * static_cast<double>(sample)));
+}
+
+inline void fillTestSignal(AudioBuffer<float>& buffer, int startSample, int numSamples, int64 streamPosition)
+{
+	for (auto channel = 0; channel < buffer.getNumChannels(); ++channel)
+		for (auto i = 0; i < numSamples; ++i)
+			buffer.setSample(channel, startSample + i, testSignal(channel, streamPosition + i));
+}
+
+
+//************* A reader producing testSignal() on every channel, as 32-bit float data, for the offline renderers ****************//
+
+class TestSignalReader : public AudioFormatReader
+{
+	public :
+
+		TestSignalReader(int channels, int64 length, double rate) : AudioFormatReader(nullptr, "test signal")
+		{
+			numChannels = static_cast<unsigned int>(channels);
+			lengthInSamples = length;
+			sampleRate = rate;
+			bitsPerSample = 32;
+			usesFloatingPointData = true;
+		}
+
+		bool readSamples(int* const* destChannels, int numDestChannels, int startOffsetInDestBuffer, int64 startSampleInFile, int numSamples) override
+		{
+			for (auto channel = 0; channel < numDestChannels; ++channel)
+			{
+				if (destChannels[channel] == nullptr)
+					continue;
+
+				float* destination = reinterpret_cast<float*>(destChannels[channel]) + startOffsetInDestBuffer;
+
+				for (auto i = 0; i < numSamples; ++i)
+				{
+					const bool inside = channel < static_cast<int>(numChannels) && startSampleInFile + i < lengthInSamples;
+					destination[i] = inside ? testSignal(channel, startSampleInFile + i) : 0.0f;
+				}
+			}
+
+			return true;
+		}
+};
+
+
+//************* A writer collecting 32-bit float output in memory, one vector per channel *****************************************//
+
+class MemoryWriter : public AudioFormatWriter
+{
+	public :
+
+		MemoryWriter(int channels, double rate) : AudioFormatWriter(nullptr, "memory", rate, static_cast<unsigned int>(channels), 32), output(static_cast<size_t>(channels))
+		{
+			usesFloatingPointData = true;
+		}
+
+		bool write(const int** samplesToWrite, int numSamples) override
+		{
+			for (size_t channel = 0; channel < output.size(); ++channel)
+			{
+				const float* source = reinterpret_cast<const float*>(samplesToWrite[channel]);
+				output[channel].insert(output[channel].end(), source, source + numSamples);
+			}
+
+			return true;
+		}
+
+		std::vector<std::vector<float>> output;
+};
@@ -0,0 +1,89 @@
+/***************************************************************************************
+Checks the argument validation of the C interface: NaN, infinite and out of range parameter
+values must be rejected without touching the effect, and the effect must keep producing finite
+output afterwards.
+****************************************************************************************/
+
+#include "bindings/c/juce_fx.h"
+#include "TestUtilities.h"
+
+#include <limits>
+
+static bool processesFiniteOutput(juce_fx_effect* effect)
+{
+	float left[512], right[512];
+	float* channels[2] = { left, right };
+
+	for (auto block = 0; block < 20; ++block)
+	{
+		for (auto i = 0; i < 512; ++i)
+		{
+			left[i] = testSignal(0, block * 512 + i);
+			right[i] = testSignal(1, block * 512 + i);
+		}
+
+		if (juce_fx_process(effect, channels, 2, 512) != JUCE_FX_OK)
+			return false;
+
+		for (auto i = 0; i < 512; ++i)
+			if (! std::isfinite(left[i]) || ! std::isfinite(right[i]))
+				return false;
+	}
+
+	return true;
+}
+
+
+int main()
+{
+	const double nan = std::numeric_limits<double>::quiet_NaN();
+	const double infinity = std::numeric_limits<double>::infinity();
+
+	for (const juce_fx_type type : { JUCE_FX_FLANGER, JUCE_FX_PITCH_SHIFTER })
+	{
+		juce_fx_effect* effect = juce_fx_create(type);
+		EXPECT(effect != nullptr);
+
+		EXPECT(juce_fx_set_param(effect, JUCE_FX_PARAM_RATE, 1.0) == JUCE_FX_ERROR_NOT_PREPARED);
+		EXPECT(juce_fx_prepare(effect, nan, 512, 2) == JUCE_FX_ERROR_INVALID_ARGUMENT);
+		EXPECT(juce_fx_prepare(effect, infinity, 512, 2) == JUCE_FX_ERROR_INVALID_ARGUMENT);
+		EXPECT(juce_fx_prepare(effect, 0.0, 512, 2) == JUCE_FX_ERROR_INVALID_ARGUMENT);
+		EXPECT(juce_fx_prepare(effect, 44100.0, 512, 2) == JUCE_FX_OK);
+
+		for (juce_fx_param param = JUCE_FX_PARAM_GAIN; param <= JUCE_FX_PARAM_PITCH_UP; ++param)
+			for (const double value : { nan, -nan, infinity, -infinity })
+				EXPECT(juce_fx_set_param(effect, param, value) == JUCE_FX_ERROR_INVALID_ARGUMENT);
+
+		EXPECT(juce_fx_set_param(effect, JUCE_FX_PARAM_MAX_DELAY_SAMPLES, 0.5) == JUCE_FX_ERROR_INVALID_ARGUMENT);
+		EXPECT(juce_fx_set_param(effect, JUCE_FX_PARAM_MAX_DELAY_SAMPLES, 441.0) == JUCE_FX_ERROR_INVALID_ARGUMENT);
+		EXPECT(juce_fx_set_param(effect, JUCE_FX_PARAM_MAX_DELAY_SAMPLES, 1.0e300) == JUCE_FX_ERROR_INVALID_ARGUMENT);
+		EXPECT(juce_fx_set_param(effect, JUCE_FX_PARAM_MAX_DELAY_SAMPLES, 200.0) == JUCE_FX_OK);
+
+		EXPECT(juce_fx_set_param(effect, JUCE_FX_PARAM_CONTROL_RATE, 0.0) == JUCE_FX_ERROR_INVALID_ARGUMENT);
+		EXPECT(juce_fx_set_param(effect, JUCE_FX_PARAM_CONTROL_RATE, 1.0e12) == JUCE_FX_ERROR_INVALID_ARGUMENT);
+		EXPECT(juce_fx_set_param(effect, JUCE_FX_PARAM_CONTROL_RATE, JUCE_FX_MAX_CONTROL_RATE + 1.0) == JUCE_FX_ERROR_INVALID_ARGUMENT);
+		EXPECT(juce_fx_set_param(effect, JUCE_FX_PARAM_CONTROL_RATE, 16.0) == JUCE_FX_OK);
+
+		EXPECT(juce_fx_set_param(effect, JUCE_FX_PARAM_RATE, -200.0) == JUCE_FX_ERROR_INVALID_ARGUMENT);
+		EXPECT(juce_fx_set_param(effect, JUCE_FX_PARAM_RATE, 22050.0) == JUCE_FX_ERROR_INVALID_ARGUMENT);
+		EXPECT(juce_fx_set_param(effect, JUCE_FX_PARAM_RATE, 1.0e30) == JUCE_FX_ERROR_INVALID_ARGUMENT);
+		EXPECT(juce_fx_set_param(effect, JUCE_FX_PARAM_RATE, 0.0) == JUCE_FX_OK);
+		EXPECT(juce_fx_set_param(effect, JUCE_FX_PARAM_RATE, 8.0) == JUCE_FX_OK);
+
+		if (type == JUCE_FX_PITCH_SHIFTER)
+			EXPECT(juce_fx_set_param(effect, JUCE_FX_PARAM_PITCH_UP, 1.0) == JUCE_FX_OK);
+
+		if (type == JUCE_FX_FLANGER)
+		{
+			EXPECT(juce_fx_set_param(effect, JUCE_FX_PARAM_FEEDBACK, 1.0) == JUCE_FX_ERROR_INVALID_ARGUMENT);
+			EXPECT(juce_fx_set_param(effect, JUCE_FX_PARAM_FEEDBACK, -1.0) == JUCE_FX_ERROR_INVALID_ARGUMENT);
+			EXPECT(juce_fx_set_param(effect, JUCE_FX_PARAM_FEEDBACK, 0.9) == JUCE_FX_OK);
+		}
+
+		EXPECT(processesFiniteOutput(effect));
+		juce_fx_destroy(effect);
+	}
+
+	std::printf("c_interface: %d failure(s)\n", testFailures);
+	return testFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,202 @@
+/***************************************************************************************
+Drives both CLAP plugins through a minimal in-process host. The plugin source is compiled into
+the test, so no binary has to be loaded. Checks that the host thread pool (one task per channel,
+each on its own thread) renders exactly what serial processing renders, that a mono input on
+the stereo output port reaches both output channels, and that non-finite parameter values are
+ignored.
+****************************************************************************************/
+
+#include "plugins/clap/juce_fx_clap.cpp"
+#include "TestUtilities.h"
+
+#include <limits>
+#include <thread>
+#include <vector>
+
+#define TEST_BLOCK_SIZE 512
+#define TEST_NUM_BLOCKS 40
+
+static bool useThreadPool = false;
+static const clap_plugin_t* currentPlugin = nullptr;
+
+
+//************* Host side: the thread pool runs every task on a thread of its own, the most concurrent schedule a host can pick ****//
+
+static bool requestExec(const clap_host_t*, uint32_t numTasks)
+{
+	if (! useThreadPool)
+		return false;
+
+	const auto* threadPool = static_cast<const clap_plugin_thread_pool_t*>(currentPlugin->get_extension(currentPlugin, CLAP_EXT_THREAD_POOL));
+	std::vector<std::thread> threads;
+
+	for (uint32_t task = 0; task < numTasks; ++task)
+		threads.emplace_back([threadPool, task] { threadPool->exec(currentPlugin, task); });
+
+	for (auto& thread : threads)
+		thread.join();
+
+	return true;
+}
+
+static const void* getHostExtension(const clap_host_t*, const char* id)
+{
+	static const clap_host_thread_pool_t threadPool = { requestExec };
+	return std::strcmp(id, CLAP_EXT_THREAD_POOL) == 0 ? &threadPool : nullptr;
+}
+
+static uint32_t noEventsSize(const clap_input_events_t*)
+{
+	return 0;
+}
+
+static const clap_event_header_t* noEventsGet(const clap_input_events_t*, uint32_t)
+{
+	return nullptr;
+}
+
+static uint32_t oneEventSize(const clap_input_events_t*)
+{
+	return 1;
+}
+
+static const clap_event_header_t* oneEventGet(const clap_input_events_t* events, uint32_t)
+{
+	return static_cast<const clap_event_header_t*>(events->ctx);
+}
+
+
+//************* Non-finite parameter values, as events or as text, must leave the parameter at its current value ****************//
+
+static void checkNonFiniteValues(uint32_t pluginIndex, clap_id rateParameter)
+{
+	const auto* factory = static_cast<const clap_plugin_factory_t*>(clap_entry.get_factory(CLAP_PLUGIN_FACTORY_ID));
+
+	clap_host_t host{};
+	host.clap_version = CLAP_VERSION_INIT;
+	host.get_extension = getHostExtension;
+
+	const clap_plugin_t* plugin = factory->create_plugin(factory, &host, factory->get_plugin_descriptor(factory, pluginIndex)->id);
+	currentPlugin = plugin;
+	plugin->init(plugin);
+	plugin->activate(plugin, 44100, 1, TEST_BLOCK_SIZE);
+
+	const auto* params = static_cast<const clap_plugin_params_t*>(plugin->get_extension(plugin, CLAP_EXT_PARAMS));
+	double before = 0.0, after = 0.0, parsed = 0.0;
+	EXPECT(params->get_value(plugin, rateParameter, &before));
+
+	for (const double value : { std::numeric_limits<double>::quiet_NaN(), std::numeric_limits<double>::infinity() })
+	{
+		clap_event_param_value_t event{};
+		event.header.size = sizeof(event);
+		event.header.space_id = CLAP_CORE_EVENT_SPACE_ID;
+		event.header.type = CLAP_EVENT_PARAM_VALUE;
+		event.param_id = rateParameter;
+		event.value = value;
+
+		clap_input_events_t events{};
+		events.ctx = &event;
+		events.size = oneEventSize;
+		events.get = oneEventGet;
+
+		params->flush(plugin, &events, nullptr);
+		EXPECT(params->get_value(plugin, rateParameter, &after) && after == before);
+	}
+
+	EXPECT(! params->text_to_value(plugin, rateParameter, "nan", &parsed));
+	EXPECT(! params->text_to_value(plugin, rateParameter, "inf", &parsed));
+	EXPECT(params->text_to_value(plugin, rateParameter, "2.5", &parsed) && parsed == 2.5);
+
+	plugin->destroy(plugin);
+}
+
+
+//************* Renders TEST_NUM_BLOCKS blocks of the test signal (numInputs channels in, stereo out) and returns the output. With ***//
+//************* dualMono, every input channel carries channel 0's signal. Output channels start out filled with garbage, so a ******//
+//************* channel the plugin does not write shows up. *************************************************************************//
+
+static std::vector<float> render(uint32_t pluginIndex, uint32_t numInputs, bool dualMono, bool threadPool)
+{
+	const auto* factory = static_cast<const clap_plugin_factory_t*>(clap_entry.get_factory(CLAP_PLUGIN_FACTORY_ID));
+
+	clap_host_t host{};
+	host.clap_version = CLAP_VERSION_INIT;
+	host.get_extension = getHostExtension;
+
+	const clap_plugin_t* plugin = factory->create_plugin(factory, &host, factory->get_plugin_descriptor(factory, pluginIndex)->id);
+	currentPlugin = plugin;
+	useThreadPool = threadPool;
+	plugin->init(plugin);
+	plugin->activate(plugin, 44100, 1, TEST_BLOCK_SIZE);
+
+	std::vector<float> inputs[2], outputs[2], result;
+	float* inputPointers[2];
+	float* outputPointers[2];
+
+	for (auto channel = 0; channel < 2; ++channel)
+	{
+		inputs[channel].resize(TEST_BLOCK_SIZE);
+		outputs[channel].resize(TEST_BLOCK_SIZE);
+		inputPointers[channel] = inputs[channel].data();
+		outputPointers[channel] = outputs[channel].data();
+	}
+
+	clap_audio_buffer_t input{}, output{};
+	input.data32 = inputPointers;
+	input.channel_count = numInputs;
+	output.data32 = outputPointers;
+	output.channel_count = 2;
+
+	clap_input_events_t events{};
+	events.size = noEventsSize;
+	events.get = noEventsGet;
+
+	clap_process_t process{};
+	process.frames_count = TEST_BLOCK_SIZE;
+	process.audio_inputs = &input;
+	process.audio_outputs = &output;
+	process.audio_inputs_count = 1;
+	process.audio_outputs_count = 1;
+	process.in_events = &events;
+
+	for (auto block = 0; block < TEST_NUM_BLOCKS; ++block)
+	{
+		for (auto channel = 0; channel < 2; ++channel)
+		{
+			for (auto i = 0; i < TEST_BLOCK_SIZE; ++i)
+				inputs[channel][i] = testSignal(dualMono ? 0 : channel, block * TEST_BLOCK_SIZE + i);
+
+			std::fill(outputs[channel].begin(), outputs[channel].end(), 1.0e30f);
+		}
+
+		plugin->process(plugin, &process);
+
+		for (auto channel = 0; channel < 2; ++channel)
+			result.insert(result.end(), outputs[channel].begin(), outputs[channel].end());
+	}
+
+	plugin->destroy(plugin);
+	return result;
+}
+
+
+int main()
+{
+	for (uint32_t pluginIndex = 0; pluginIndex < 2; ++pluginIndex)
+	{
+		const std::vector<float> serial = render(pluginIndex, 2, false, false);
+		const std::vector<float> threaded = render(pluginIndex, 2, false, true);
+		EXPECT(serial == threaded);
+
+		// a mono input feeds both output channels, exactly like a stereo input carrying the same signal twice
+		const std::vector<float> mono = render(pluginIndex, 1, true, true);
+		const std::vector<float> dualMono = render(pluginIndex, 2, true, false);
+		EXPECT(mono == dualMono);
+	}
+
+	checkNonFiniteValues(0, flangerRate);
+	checkNonFiniteValues(1, pitchRate);
+
+	std::printf("clap_plugin: %d failure(s)\n", testFailures);
+	return testFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,147 @@
+/***************************************************************************************
+Renders the effects in deterministic mode and writes the raw output to the file named on the
+command line. CMake builds this file once per instruction set (scalar, SSE, AVX + FMA) and
+compares the files byte for byte, so a kernel change that lets the compiler contract or reorder
+the deterministic arithmetic fails here. Within one build, every render is also repeated with
+other block splits and tilings, which must not change a single bit either.
+****************************************************************************************/
+
+#include "Flanger.h"
+#include "PitchShifter.h"
+#include "TileScheduler.h"
+#include "TestUtilities.h"
+
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#ifndef JUCE_FX_TEST_ISA
+ #define JUCE_FX_TEST_ISA "default"
+#endif
+
+#define RENDER_LENGTH 20000
+#define MAX_BLOCK_SIZE 1024
+#define MAX_DELAY_SAMPLES 300
+
+enum class Route { tiled, perChannel, midSide };
+
+
+//************* Runs the stream through the effect in blocks of the given sizes (cycled) and appends both channels' output. *******//
+
+template <typename Effect>
+static void render(Effect& effect, Route route, const std::vector<int>& splits, std::vector<float>& output)
+{
+	AudioBuffer<float> buffer(2, MAX_BLOCK_SIZE);
+	std::vector<float> channels[2];
+	TileScheduler scheduler;
+	scheduler.setTileSize(16);
+
+	for (int64 position = 0, block = 0; position < RENDER_LENGTH; ++block)
+	{
+		const int numSamples = static_cast<int>(jmin(static_cast<int64>(splits[block % splits.size()]), RENDER_LENGTH - position));
+		fillTestSignal(buffer, 0, numSamples, position);
+
+		if (route == Route::tiled)
+		{
+			scheduler.setFixedTileKernels((block & 1) != 0);
+			scheduler.process(&buffer, 0, numSamples, makeChainStage(effect, MAX_DELAY_SAMPLES, 0.9f));
+		}
+		else
+		{
+			if constexpr (std::is_same<Effect, Flanger>::value)
+				if (route == Route::midSide)
+					effect.processMidSide(&buffer, 0, numSamples, MAX_DELAY_SAMPLES, 0.9f);
+
+			if (route == Route::perChannel)
+				for (auto channel = 0; channel < 2; ++channel)
+					effect.process(&buffer, 0, numSamples, MAX_DELAY_SAMPLES, channel, 0.9f);
+
+			effect.adjustWritePositions(numSamples);
+		}
+
+		for (auto channel = 0; channel < 2; ++channel)
+			channels[channel].insert(channels[channel].end(), buffer.getReadPointer(channel), buffer.getReadPointer(channel) + numSamples);
+
+		position += numSamples;
+	}
+
+	for (auto& channel : channels)
+		output.insert(output.end(), channel.begin(), channel.end());
+}
+
+
+//************* Every configuration the deterministic kernels have a separate code path for ***************************************//
+
+static std::vector<float> renderAll(const std::vector<int>& splits)
+{
+	std::vector<float> output;
+
+	Flanger flanger;
+	flanger.initialize(MAX_BLOCK_SIZE, 44100);
+	flanger.setDeterministic(true);
+	flanger.setDepth(0.7f);
+	flanger.setLFO(0.5f);
+	flanger.setFeedback(0.5f);
+	flanger.setControlRate(16);
+	render(flanger, Route::tiled, splits, output);
+
+	Flanger shaped;
+	shaped.initialize(MAX_BLOCK_SIZE, 44100);
+	shaped.setDeterministic(true);
+	shaped.setDepth(1.0f);
+	shaped.setLFO(2.0f);
+	shaped.setFeedback(0.9f);
+	shaped.setFeedbackDamping(0.3f);
+	shaped.setFeedbackSaturation(true);
+	render(shaped, Route::perChannel, splits, output);
+
+	Flanger midSide;
+	midSide.initialize(MAX_BLOCK_SIZE, 44100);
+	midSide.setDeterministic(true);
+	midSide.setMidSideComponents(true, true);
+	midSide.setFeedback(0.3f);
+	midSide.setControlRate(32);
+	render(midSide, Route::midSide, splits, output);
+
+	PitchShifter pitchShifter;
+	pitchShifter.initialize(MAX_BLOCK_SIZE, 44100);
+	pitchShifter.setDeterministic(true);
+	pitchShifter.setLevel(20.0f);
+	pitchShifter.setUp();
+	pitchShifter.setControlRate(16);
+	render(pitchShifter, Route::tiled, splits, output);
+
+	return output;
+}
+
+
+int main(int argc, char** argv)
+{
+	if (argc != 2)
+	{
+		std::fprintf(stderr, "usage: %s <output file>\n", argv[0]);
+		return 2;
+	}
+
+	const std::vector<std::vector<int>> splitSets = { { 512 }, { 37, 256, 5, 100 }, { 1024, 1, 64 } };
+	const std::vector<float> reference = renderAll(splitSets[0]);
+
+	for (size_t set = 1; set < splitSets.size(); ++set)
+	{
+		const std::vector<float> output = renderAll(splitSets[set]);
+		EXPECT(output.size() == reference.size());
+		EXPECT(std::memcmp(output.data(), reference.data(), sizeof(float) * jmin(output.size(), reference.size())) == 0);
+	}
+
+	FILE* file = std::fopen(argv[1], "wb");
+	EXPECT(file != nullptr);
+
+	if (file != nullptr)
+	{
+		EXPECT(std::fwrite(reference.data(), sizeof(float), reference.size(), file) == reference.size());
+		std::fclose(file);
+	}
+
+	std::printf("%s: %d failure(s), %zu samples written to %s\n", JUCE_FX_TEST_ISA, testFailures, reference.size(), argv[1]);
+	return testFailures == 0 ? 0 : 1;
+}
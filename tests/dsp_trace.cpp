@@ -0,0 +1,76 @@
+/***************************************************************************************
+Traces a Flanger processed on many short-lived threads, one after the other, as the offline
+renderers do. Every thread must get a ring (they are recycled when a thread exits), so no event
+may be dropped however many threads have come and gone, also across a second start().
+****************************************************************************************/
+
+#define JUCE_FX_ENABLE_TRACING 1
+
+#include "DspTrace.h"
+#include "Flanger.h"
+#include "TestUtilities.h"
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#define TEST_BLOCK_SIZE 512
+#define TEST_THREADS (4 * MAX_TRACE_THREADS)
+#define TEST_TRACE_FILE "dsp_trace_test.json"
+
+//************* Runs one block through the flanger on each of TEST_THREADS threads in turn and returns the finished trace ********//
+
+static std::string traceThreads(Flanger& flanger)
+{
+	EXPECT(DspTrace::getInstance().start(TEST_TRACE_FILE));
+
+	for (auto index = 0; index < TEST_THREADS; ++index)
+	{
+		std::thread([&flanger, index]
+		{
+			AudioBuffer<float> buffer(2, TEST_BLOCK_SIZE);
+			fillTestSignal(buffer, 0, TEST_BLOCK_SIZE, static_cast<int64>(index) * TEST_BLOCK_SIZE);
+
+			for (auto channel = 0; channel < 2; ++channel)
+				flanger.process(&buffer, 0, TEST_BLOCK_SIZE, 300, channel, 1.0f);
+
+			flanger.adjustWritePositions(TEST_BLOCK_SIZE);
+		}).join();
+	}
+
+	DspTrace::getInstance().stop();
+
+	std::ifstream file(TEST_TRACE_FILE);
+	std::stringstream contents;
+	contents << file.rdbuf();
+	std::remove(TEST_TRACE_FILE);
+	return contents.str();
+}
+
+static int countOccurrences(const std::string& text, const std::string& pattern)
+{
+	int count = 0;
+
+	for (size_t position = text.find(pattern); position != std::string::npos; position = text.find(pattern, position + 1))
+		++count;
+
+	return count;
+}
+
+
+int main()
+{
+	Flanger flanger;
+	flanger.initialize(TEST_BLOCK_SIZE, 44100.0);
+
+	for (auto session = 0; session < 2; ++session)
+	{
+		const std::string trace = traceThreads(flanger);
+		EXPECT(trace.find("\"droppedEvents\":\"0\"") != std::string::npos);
+		EXPECT(countOccurrences(trace, "\"name\":\"Flanger process\"") == 2 * TEST_THREADS);
+	}
+
+	std::printf("dsp_trace: %d failure(s)\n", testFailures);
+	return testFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,155 @@
+/***************************************************************************************
+Swaps an EffectSwapper between configurations with different channel counts, sample rates and
+block sizes (so different delay line sizes) while an audio thread keeps processing, and checks
+that the audio thread never allocates or frees: the global operator new/delete are replaced and
+count every call made while the thread_local audio thread flag is set.
+****************************************************************************************/
+
+#include "EffectSwapper.h"
+#include "Flanger.h"
+#include "PitchShifter.h"
+#include "TestUtilities.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <thread>
+
+#define TEST_BLOCK_SIZE 256
+#define TEST_SAMPLE_RATE 44100.0
+#define TEST_BLOCKS_PER_CONFIGURATION 40
+
+static thread_local bool onAudioThread = false;
+static std::atomic<int> audioThreadAllocations{ 0 };
+
+
+//************* Replacement global allocation functions. The sized, aligned and nothrow forms not replaced here forward to these *//
+
+void* operator new(std::size_t size)
+{
+	if (onAudioThread)
+		++audioThreadAllocations;
+
+	if (void* memory = std::malloc(size == 0 ? 1 : size))
+		return memory;
+
+	throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* memory) noexcept
+{
+	if (onAudioThread && memory != nullptr)
+		++audioThreadAllocations;
+
+	std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	operator delete(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+	operator delete(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept
+{
+	operator delete(memory);
+}
+
+
+struct Configuration
+{
+	int blockSize;
+	double sampleRate;
+	int numChannels;
+	int maxDelayInSamples;
+};
+
+// every neighbouring pair differs in channel count or delay line size; restoring the state works across block sizes only
+static const Configuration configurations[] = {
+	{ 512, 44100.0, 2, 300 },
+	{ 2048, 44100.0, 1, 600 },
+	{ 1024, 48000.0, 2, 100 },
+	{ 4096, 44100.0, 2, 300 },
+	{ 256, 96000.0, 1, 50 },
+	{ 512, 44100.0, 2, 300 },
+};
+
+
+//************* The background thread publishes every configuration while the audio thread processes blocks of a stereo buffer **//
+
+template <typename Effect, typename Configure>
+static void swapWhileProcessing(Configure configure)
+{
+	EffectSwapper<Effect> swapper;
+	swapper.initialize(TEST_BLOCK_SIZE, TEST_SAMPLE_RATE, 2);
+
+	const int numConfigurations = static_cast<int>(sizeof(configurations) / sizeof(configurations[0]));
+	const int numBlocks = numConfigurations * TEST_BLOCKS_PER_CONFIGURATION;
+	std::atomic<int> blocksDone{ 0 };
+	bool finite = true;
+
+	AudioBuffer<float> buffer(2, TEST_BLOCK_SIZE);
+
+	std::thread audioThread([&]
+	{
+		onAudioThread = true;
+
+		for (auto block = 0; block < numBlocks; ++block)
+		{
+			fillTestSignal(buffer, 0, TEST_BLOCK_SIZE, static_cast<int64>(block) * TEST_BLOCK_SIZE);
+			swapper.process(&buffer, 0, TEST_BLOCK_SIZE, 1.0f);
+
+			for (auto channel = 0; channel < 2; ++channel)
+				for (auto i = 0; i < TEST_BLOCK_SIZE; ++i)
+					finite = finite && std::isfinite(buffer.getSample(channel, i));
+
+			blocksDone.store(block + 1, std::memory_order_release);
+		}
+
+		onAudioThread = false;
+	});
+
+	for (auto index = 0; index < numConfigurations; ++index)
+	{
+		while (blocksDone.load(std::memory_order_acquire) < index * TEST_BLOCKS_PER_CONFIGURATION)
+			std::this_thread::yield();
+
+		const Configuration& configuration = configurations[index];
+		swapper.prepare(configuration.blockSize, configuration.sampleRate, configuration.numChannels, configuration.maxDelayInSamples, configure);
+	}
+
+	audioThread.join();
+	swapper.reclaim();
+
+	EXPECT(finite);
+}
+
+
+int main()
+{
+	swapWhileProcessing<Flanger>([] (Flanger& flanger)
+	{
+		flanger.setDepth(0.7f);
+		flanger.setLFO(1.0f);
+		flanger.setFeedback(0.5f);
+	});
+
+	swapWhileProcessing<PitchShifter>([] (PitchShifter& pitchShifter)
+	{
+		pitchShifter.setLevel(8.0f);
+	});
+
+	EXPECT(audioThreadAllocations.load() == 0);
+
+	std::printf("effect_swapper: %d allocation(s) on the audio thread, %d failure(s)\n", audioThreadAllocations.load(), testFailures);
+	return testFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,78 @@
+/***************************************************************************************
+Tunes a chain whose Flanger takes its LFO from a ModulationBus. The benchmark copies must not
+read the bus (nobody renders it for them), which the bus position assertion in Flanger checks.
+NDEBUG is undefined so assert() based assertions stay on in release builds; JUCE's own jassert
+follows JUCE_DEBUG instead, so there the check needs a debug build. Also checks that the cache
+file tells chains with the same number of stages apart.
+****************************************************************************************/
+
+#undef NDEBUG
+
+#include "Flanger.h"
+#include "KernelAutotuner.h"
+#include "ModulationBus.h"
+#include "PitchShifter.h"
+#include "TestUtilities.h"
+
+#define TEST_BLOCK_SIZE 512
+#define TEST_SAMPLE_RATE 44100.0
+#define TEST_MAX_DELAY 300
+
+int main()
+{
+	ModulationBus bus;
+	bus.prepare(TEST_BLOCK_SIZE, TEST_SAMPLE_RATE);
+	const int lfo = bus.getLFO(0.5f);
+
+	Flanger flanger;
+	flanger.initialize(TEST_BLOCK_SIZE, TEST_SAMPLE_RATE);
+	flanger.setModulationBus(&bus, lfo, 0.25f);
+
+	PitchShifter pitchShifter;
+	pitchShifter.initialize(TEST_BLOCK_SIZE, TEST_SAMPLE_RATE);
+
+	TileScheduler scheduler;
+	scheduler.initialize(2, 2);
+
+	KernelAutotuner tuner;
+	const KernelChoice choice = tuner.tune(scheduler, TEST_BLOCK_SIZE, 2, makeChainStage(flanger, TEST_MAX_DELAY, 1.0f), makeChainStage(pitchShifter, TEST_MAX_DELAY, 1.0f));
+	EXPECT(choice.tileSize >= MIN_TILE_SIZE && choice.tileSize <= jmin(TEST_BLOCK_SIZE, MAX_TILE_SIZE));
+
+	// the original stays subscribed: with the bus rendered it processes a block as before
+	AudioBuffer<float> buffer(2, TEST_BLOCK_SIZE);
+	fillTestSignal(buffer, 0, TEST_BLOCK_SIZE, 0);
+	bus.render(TEST_BLOCK_SIZE);
+	scheduler.process(&buffer, 0, TEST_BLOCK_SIZE, makeChainStage(flanger, TEST_MAX_DELAY, 1.0f), makeChainStage(pitchShifter, TEST_MAX_DELAY, 1.0f));
+
+	// the cache file keys the choice by the effect types: a chain with the same number of stages gets its own entry
+	const std::string cachePath = "kernel_autotuner_cache.txt";
+	std::remove(cachePath.c_str());
+
+	const auto countCacheLines = [&cachePath]
+	{
+		int lines = 0;
+
+		if (std::FILE* file = std::fopen(cachePath.c_str(), "r"))
+		{
+			for (int c = std::fgetc(file); c != EOF; c = std::fgetc(file))
+				lines += c == '\n' ? 1 : 0;
+
+			std::fclose(file);
+		}
+
+		return lines;
+	};
+
+	flanger.setModulationBus(nullptr);
+	KernelAutotuner cachingTuner(cachePath);
+	cachingTuner.tune(scheduler, TEST_BLOCK_SIZE, 2, makeChainStage(flanger, TEST_MAX_DELAY, 1.0f), makeChainStage(pitchShifter, TEST_MAX_DELAY, 1.0f));
+	EXPECT(countCacheLines() == 1);
+	cachingTuner.tune(scheduler, TEST_BLOCK_SIZE, 2, makeChainStage(pitchShifter, TEST_MAX_DELAY, 1.0f), makeChainStage(flanger, TEST_MAX_DELAY, 1.0f));
+	EXPECT(countCacheLines() == 2);
+	cachingTuner.tune(scheduler, TEST_BLOCK_SIZE, 2, makeChainStage(flanger, TEST_MAX_DELAY, 1.0f), makeChainStage(pitchShifter, TEST_MAX_DELAY, 1.0f));
+	EXPECT(countCacheLines() == 2);
+	std::remove(cachePath.c_str());
+
+	std::printf("kernel_autotuner: tile %d, fixed kernels %d, %d failure(s)\n", choice.tileSize, choice.fixedTileKernels ? 1 : 0, testFailures);
+	return testFailures == 0 ? 0 : 1;
+}
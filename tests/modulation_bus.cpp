@@ -0,0 +1,98 @@
+/***************************************************************************************
+A Flanger subscribed to a ModulationBus: the offline renderers own no bus and must refuse it
+instead of silently falling back to the own LFO, and a process() call the bus was not rendered
+for must be reported to the DiagnosticLog. An invalid LFO index (a full bus) is ignored.
+****************************************************************************************/
+
+#include "DiagnosticLog.h"
+#include "Flanger.h"
+#include "ModulationBus.h"
+#include "OfflineRenderer.h"
+#include "RenderCache.h"
+#include "RenderFarm.h"
+#include "RenderSession.h"
+#include "TestUtilities.h"
+
+#define TEST_BLOCK_SIZE 4096
+#define TEST_SAMPLE_RATE 44100.0
+#define TEST_LENGTH (2 * 44100)
+#define TEST_MAX_DELAY 300
+
+//************* Number of modulationBusNotRendered records after processing one block of length samples with the bus rendered ***//
+//************* for rendered samples *************************************************************************************************//
+
+static int countUnrenderedBusRecords(Flanger& flanger, ModulationBus& bus, DiagnosticLog& log, int length, int rendered)
+{
+	AudioBuffer<float> buffer(2, TEST_BLOCK_SIZE);
+	fillTestSignal(buffer, 0, TEST_BLOCK_SIZE, 0);
+	bus.render(rendered);
+
+	for (auto channel = 0; channel < 2; ++channel)
+		flanger.process(&buffer, 0, length, TEST_MAX_DELAY, channel, 1.0f);
+
+	flanger.adjustWritePositions(length);
+
+	int count = 0;
+	log.drain([&] (const DiagnosticRecord& record) { count += record.event == DiagnosticEvent::modulationBusNotRendered ? 1 : 0; });
+	return count;
+}
+
+
+int main()
+{
+	ModulationBus bus;
+	bus.prepare(TEST_BLOCK_SIZE, TEST_SAMPLE_RATE);
+
+	Flanger flanger;
+	flanger.initialize(TEST_BLOCK_SIZE, TEST_SAMPLE_RATE);
+	flanger.setModulationBus(&bus, bus.getLFO(0.5f), 0.25f);
+
+	TestSignalReader reader(2, TEST_LENGTH, TEST_SAMPLE_RATE);
+	MemoryWriter writer(2, TEST_SAMPLE_RATE);
+
+	OfflineRenderer offline(TEST_BLOCK_SIZE);
+	EXPECT(! offline.render(reader, writer, makeChainStage(flanger, TEST_MAX_DELAY, 1.0f)));
+
+	RenderFarm farm(2, TEST_BLOCK_SIZE);
+	EXPECT(! farm.render(reader, writer, makeChainStage(flanger, TEST_MAX_DELAY, 1.0f)));
+
+	RenderCache cache("/nonexistent", TEST_BLOCK_SIZE);
+	EXPECT(! cache.render(reader, writer, makeChainStage(flanger, TEST_MAX_DELAY, 1.0f)));
+
+	RenderSession<Flanger> session(reader, 0, makeChainStage(flanger, TEST_MAX_DELAY, 1.0f));
+	EXPECT(! session.render());
+	EXPECT(! session.rerender(0, TEST_LENGTH));
+	EXPECT(writer.output[0].empty());
+
+	// a block the bus rendered is not reported, one reaching past it is, once per channel
+	DiagnosticLog log;
+	flanger.setDiagnosticLog(&log);
+	EXPECT(countUnrenderedBusRecords(flanger, bus, log, 1024, 1024) == 0);
+	EXPECT(countUnrenderedBusRecords(flanger, bus, log, 1024, 512) == 2);
+
+	// a full bus: getLFO() returns -1, which setModulationBus() and the accessors ignore (they assert first, so release builds only)
+   #ifdef NDEBUG
+	ModulationBus fullBus;
+	fullBus.prepare(TEST_BLOCK_SIZE, TEST_SAMPLE_RATE);
+
+	for (auto index = 0; index < MAX_BUS_LFOS; ++index)
+		EXPECT(fullBus.getLFO(1.0f + index) == index);
+
+	const int invalid = fullBus.getLFO(100.0f);
+	EXPECT(invalid == -1 && ! fullBus.isValidLFO(invalid) && ! fullBus.isValidLFO(MAX_BUS_LFOS));
+	EXPECT(fullBus.getSine(invalid) == nullptr && fullBus.getCosine(invalid) == nullptr && fullBus.getFrequency(invalid) == 0.0f);
+
+	Flanger unsubscribed;
+	unsubscribed.initialize(TEST_BLOCK_SIZE, TEST_SAMPLE_RATE);
+	unsubscribed.setModulationBus(&fullBus, invalid);
+	EXPECT(unsubscribed.getModulationBus() == nullptr);
+   #endif
+
+	// unsubscribed, the same chain renders
+	flanger.setModulationBus(nullptr);
+	EXPECT(offline.render(reader, writer, makeChainStage(flanger, TEST_MAX_DELAY, 1.0f)));
+	EXPECT(writer.output[0].size() == static_cast<size_t>(TEST_LENGTH));
+
+	std::printf("modulation_bus: %d failure(s)\n", testFailures);
+	return testFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,124 @@
+/***************************************************************************************
+Checks the crossover network of the MultibandFlanger. With every band depth and the feedback
+at 0 each band passes its crossover lane unchanged, so the summed output must be the input
+through the cascade of the 2nd order allpasses of the crossovers in use (a 4th order
+Linkwitz-Riley low pass plus high pass is that allpass), computed here in double precision.
+****************************************************************************************/
+
+#include "MultibandFlanger.h"
+#include "TestUtilities.h"
+
+#define TEST_BLOCK_SIZE 256
+#define TEST_BLOCKS 32
+#define TEST_CHANNELS 2
+#define TEST_SAMPLE_RATE 44100.0
+#define TEST_TOLERANCE 1.0e-3			// the float sections deviate by about 1e-4 with a crossover as low as 120 Hz
+
+//************* Reference 2nd order allpass at the frequency of one crossover, same coefficients as updateCrossovers() *************//
+
+struct ReferenceAllpass
+{
+	double b0, b1, b2, a1, a2;
+	double x1{ 0 }, x2{ 0 }, y1{ 0 }, y2{ 0 };
+
+	ReferenceAllpass(double frequency, double sampleRate)
+	{
+		const double w0 = 2.0 * double_Pi * frequency / sampleRate;
+		const double cosw = std::cos(w0), alpha = std::sin(w0) / std::sqrt(2.0);		// q = 1 / sqrt(2)
+		const double a0 = 1.0 + alpha;
+
+		b0 = (1.0 - alpha) / a0;
+		b1 = -2.0 * cosw / a0;
+		b2 = 1.0;
+		a1 = b1;
+		a2 = b0;
+	}
+
+	double process(double x)
+	{
+		const double y = b0 * x + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2;
+		x2 = x1; x1 = x;
+		y2 = y1; y1 = y;
+		return y;
+	}
+};
+
+
+//************* Runs TEST_BLOCKS blocks of the test signal through a flanger with numBands bands and compares every sample to *****//
+//************* the reference allpass cascade. Also checks that the result is not simply the input, which would pass trivially. ***//
+
+static void checkAllpassSum(int numBands, const float* crossovers)
+{
+	MultibandFlanger flanger;
+	flanger.initialize(TEST_BLOCK_SIZE, TEST_SAMPLE_RATE, TEST_CHANNELS);
+	flanger.setNumBands(numBands);
+	flanger.setFeedback(0.0f);
+
+	for (auto band = 0; band < MAX_FLANGER_BANDS; ++band)
+	{
+		flanger.setBandDepth(band, 0.0f);
+		flanger.setBandLFO(band, 0.5f + band);
+	}
+
+	for (auto crossover = 0; crossover < MAX_FLANGER_BANDS - 1; ++crossover)
+		flanger.setCrossoverFrequency(crossover, crossovers[crossover]);
+
+	EXPECT(flanger.getNumBands() == numBands);
+
+	std::vector<std::vector<ReferenceAllpass>> reference(TEST_CHANNELS);
+
+	for (auto channel = 0; channel < TEST_CHANNELS; ++channel)
+		for (auto crossover = 0; crossover < numBands - 1; ++crossover)
+			reference[static_cast<size_t>(channel)].emplace_back(crossovers[crossover], TEST_SAMPLE_RATE);
+
+	AudioBuffer<float> buffer(TEST_CHANNELS, TEST_BLOCK_SIZE);
+	double maxError = 0, maxPhaseShift = 0;
+
+	for (auto block = 0; block < TEST_BLOCKS; ++block)
+	{
+		const int64 position = static_cast<int64>(block) * TEST_BLOCK_SIZE;
+		fillTestSignal(buffer, 0, TEST_BLOCK_SIZE, position);
+
+		for (auto channel = 0; channel < TEST_CHANNELS; ++channel)
+			flanger.process(&buffer, 0, TEST_BLOCK_SIZE, 200, channel, 1.0f);
+
+		flanger.adjustWritePositions(TEST_BLOCK_SIZE);
+
+		for (auto channel = 0; channel < TEST_CHANNELS; ++channel)
+		{
+			for (auto i = 0; i < TEST_BLOCK_SIZE; ++i)
+			{
+				const double input = testSignal(channel, position + i);
+				double expected = input;
+
+				for (auto& allpass : reference[static_cast<size_t>(channel)])
+					expected = allpass.process(expected);
+
+				maxError = jmax(maxError, std::abs(buffer.getSample(channel, i) - expected));
+				maxPhaseShift = jmax(maxPhaseShift, std::abs(expected - input));
+			}
+		}
+	}
+
+	EXPECT(maxError < TEST_TOLERANCE);
+	EXPECT(maxPhaseShift > 50 * TEST_TOLERANCE);
+
+	if (maxError >= TEST_TOLERANCE)
+		std::fprintf(stderr, "%d bands: largest deviation from the allpass %g\n", numBands, maxError);
+}
+
+
+int main()
+{
+	const float defaultCrossovers[MAX_FLANGER_BANDS - 1] = { 300.0f, 2000.0f, 8000.0f };
+	const float otherCrossovers[MAX_FLANGER_BANDS - 1] = { 120.0f, 900.0f, 5000.0f };
+
+	for (auto numBands = 2; numBands <= MAX_FLANGER_BANDS; ++numBands)
+	{
+		checkAllpassSum(numBands, defaultCrossovers);
+		checkAllpassSum(numBands, otherCrossovers);
+	}
+
+	std::printf("multiband_flanger: %d failure(s)\n", testFailures);
+	return testFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,62 @@
+# Smoke test of the juce_fx Python module: both effects process a stereo array and a batch of clips in place with finite
+# output, and invalid arguments raise ValueError instead of reaching the DSP. Exits with 77 (skipped) without NumPy.
+
+import math
+import sys
+
+try:
+    import numpy as np
+except ImportError:
+    print("python_bindings: NumPy is not installed, skipped")
+    sys.exit(77)
+
+import juce_fx
+
+failures = 0
+
+
+def expect(condition, what):
+    global failures
+    if not condition:
+        print("check failed: " + what, file=sys.stderr)
+        failures += 1
+
+
+def raises_value_error(call, *args):
+    try:
+        call(*args)
+    except ValueError:
+        return True
+    return False
+
+
+t = np.arange(10000, dtype=np.float32)
+stereo = np.stack([0.5 * np.sin(0.01 * t), 0.5 * np.sin(0.02 * t)]).astype(np.float32)
+clips = np.stack([0.5 * np.sin(0.01 * (n + 1) * t) for n in range(4)]).astype(np.float32)
+
+flanger = juce_fx.Flanger(sample_rate=44100, max_block_size=512, channels=2)
+flanger.set_depth(0.7)
+flanger.set_lfo(0.5)
+
+pitch_shifter = juce_fx.PitchShifter(sample_rate=44100, max_block_size=512, channels=2)
+pitch_shifter.set_level(8.0)
+
+for name, effect in (("Flanger", flanger), ("PitchShifter", pitch_shifter)):
+    audio = stereo.copy()
+    effect.process(audio, max_delay_samples=300)
+    expect(np.all(np.isfinite(audio)) and not np.array_equal(audio, stereo), name + ".process")
+
+    batch = clips.copy()
+    effect.process_batch(batch, max_delay_samples=300)
+    expect(np.all(np.isfinite(batch)), name + ".process_batch")
+
+    expect(raises_value_error(effect.process, stereo.copy(), 0), name + ".process with max_delay_samples 0")
+
+for rate in (-200.0, math.nan, math.inf, 22050.0):
+    expect(raises_value_error(flanger.set_lfo, rate), "Flanger.set_lfo(%r)" % rate)
+    expect(raises_value_error(pitch_shifter.set_level, rate), "PitchShifter.set_level(%r)" % rate)
+
+expect(raises_value_error(juce_fx.Flanger, 44100, 512, 32), "Flanger with 32 channels")
+
+print("python_bindings: %d failure(s)" % failures)
+sys.exit(1 if failures else 0)
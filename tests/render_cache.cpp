@@ -0,0 +1,91 @@
+/***************************************************************************************
+Renders the same input and settings through two RenderCache instances on two threads at once,
+so both store the same key concurrently, then checks that the stored entry is a complete render
+identical to an OfflineRenderer pass.
+****************************************************************************************/
+
+#include "Flanger.h"
+#include "OfflineRenderer.h"
+#include "RenderCache.h"
+#include "TestUtilities.h"
+
+#include <sys/stat.h>
+#include <thread>
+
+#define TEST_BLOCK_SIZE 4096
+#define TEST_SAMPLE_RATE 44100.0
+#define TEST_LENGTH (3 * 44100 + 17)
+#define TEST_MAX_DELAY 300
+#define TEST_CACHE_DIRECTORY "render_cache_test"
+
+static void initializeFlanger(Flanger& flanger)
+{
+	flanger.initialize(TEST_BLOCK_SIZE, TEST_SAMPLE_RATE);
+	flanger.setDepth(0.7f);
+	flanger.setLFO(1.0f);
+	flanger.setFeedback(0.5f);
+}
+
+static void removeCacheDirectory()
+{
+	std::system("rm -rf " TEST_CACHE_DIRECTORY);
+}
+
+
+int main()
+{
+	removeCacheDirectory();
+	mkdir(TEST_CACHE_DIRECTORY, 0755);
+
+	bool rendered[2] = { false, false };
+	std::thread renderers[2];
+
+	for (auto index = 0; index < 2; ++index)
+	{
+		renderers[index] = std::thread([index, &rendered]
+		{
+			TestSignalReader reader(2, TEST_LENGTH, TEST_SAMPLE_RATE);
+			MemoryWriter writer(2, TEST_SAMPLE_RATE);
+			Flanger flanger;
+			initializeFlanger(flanger);
+
+			RenderCache cache(TEST_CACHE_DIRECTORY, TEST_BLOCK_SIZE);
+			rendered[index] = cache.render(reader, writer, makeChainStage(flanger, TEST_MAX_DELAY, 1.0f));
+		});
+	}
+
+	for (auto& renderer : renderers)
+		renderer.join();
+
+	EXPECT(rendered[0] && rendered[1]);
+
+	TestSignalReader reader(2, TEST_LENGTH, TEST_SAMPLE_RATE);
+	MemoryWriter expected(2, TEST_SAMPLE_RATE);
+	Flanger flanger;
+	initializeFlanger(flanger);
+
+	OfflineRenderer offline(TEST_BLOCK_SIZE);
+	EXPECT(offline.render(reader, expected, makeChainStage(flanger, TEST_MAX_DELAY, 1.0f)));
+
+	flanger.reset();
+	RenderCache cache(TEST_CACHE_DIRECTORY, TEST_BLOCK_SIZE);
+	CachedRender cached;
+	const bool found = cache.lookup(reader, cached, makeChainStage(flanger, TEST_MAX_DELAY, 1.0f));
+	EXPECT(found && cached.getNumChannels() == 2 && cached.getNumSamples() == TEST_LENGTH);
+
+	if (found && cached.getNumChannels() == 2 && cached.getNumSamples() == TEST_LENGTH)
+	{
+		bool identical = true;
+
+		for (auto channel = 0; channel < 2; ++channel)
+			for (auto i = 0; i < TEST_LENGTH; ++i)
+				identical = identical && cached.getReadPointer(channel)[i] == expected.output[static_cast<size_t>(channel)][static_cast<size_t>(i)];
+
+		EXPECT(identical);
+	}
+
+	removeCacheDirectory();
+
+	std::printf("render_cache: %d failure(s)\n", testFailures);
+	return testFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,87 @@
+/***************************************************************************************
+Renders a Flanger -> PitchShifter chain at control rate 16 with a RenderFarm (several forked
+workers) and with a single-pass OfflineRenderer, and compares the two. Without feedback they must
+be bit-identical; with feedback the pre-roll derived from the feedback decay must keep the
+difference below -120 dB.
+****************************************************************************************/
+
+#include "Flanger.h"
+#include "OfflineRenderer.h"
+#include "PitchShifter.h"
+#include "RenderFarm.h"
+#include "TestUtilities.h"
+
+#define TEST_SAMPLE_RATE 44100.0
+#define TEST_LENGTH (5 * 44100 + 123)
+#define TEST_CONTROL_RATE 16
+#define TEST_MAX_DELAY 300
+
+struct Chain
+{
+	Flanger flanger;
+	PitchShifter pitchShifter;
+
+	Chain(bool deterministic, float feedback)
+	{
+		flanger.initialize(DEFAULT_FARM_BLOCK_SIZE, TEST_SAMPLE_RATE);
+		flanger.setDeterministic(deterministic);
+		flanger.setDepth(0.7f);
+		flanger.setLFO(1.0f);
+		flanger.setFeedback(feedback);
+		flanger.setControlRate(TEST_CONTROL_RATE);
+
+		pitchShifter.initialize(DEFAULT_FARM_BLOCK_SIZE, TEST_SAMPLE_RATE);
+		pitchShifter.setDeterministic(deterministic);
+		pitchShifter.setLevel(8.0f);
+		pitchShifter.setControlRate(TEST_CONTROL_RATE);
+	}
+};
+
+
+//************* Largest difference between a farm render and a single-pass render, or -1 if a render failed ***********************//
+
+static float compareRenders(bool deterministic, float feedback)
+{
+	TestSignalReader reader(2, TEST_LENGTH, TEST_SAMPLE_RATE);
+	MemoryWriter serialOutput(2, TEST_SAMPLE_RATE), farmOutput(2, TEST_SAMPLE_RATE);
+	Chain serialChain(deterministic, feedback), farmChain(deterministic, feedback);
+
+	OfflineRenderer serial;
+	RenderFarm farm(4);
+
+	if (! serial.render(reader, serialOutput, makeChainStage(serialChain.flanger, TEST_MAX_DELAY, 1.0f), makeChainStage(serialChain.pitchShifter, TEST_MAX_DELAY, 1.0f)))
+		return -1.0f;
+
+	if (! farm.render(reader, farmOutput, makeChainStage(farmChain.flanger, TEST_MAX_DELAY, 1.0f), makeChainStage(farmChain.pitchShifter, TEST_MAX_DELAY, 1.0f)))
+		return -1.0f;
+
+	float difference = 0.0f;
+
+	for (size_t channel = 0; channel < 2; ++channel)
+	{
+		if (serialOutput.output[channel].size() != static_cast<size_t>(TEST_LENGTH) || farmOutput.output[channel].size() != static_cast<size_t>(TEST_LENGTH))
+			return -1.0f;
+
+		for (size_t i = 0; i < serialOutput.output[channel].size(); ++i)
+			difference = jmax(difference, std::abs(serialOutput.output[channel][i] - farmOutput.output[channel][i]));
+	}
+
+	return difference;
+}
+
+
+int main()
+{
+	for (const bool deterministic : { false, true })
+	{
+		const float withoutFeedback = compareRenders(deterministic, 0.0f);
+		const float withFeedback = compareRenders(deterministic, 0.5f);
+
+		std::printf("%s: difference without feedback %g, with feedback %g\n", deterministic ? "deterministic" : "default", withoutFeedback, withFeedback);
+		EXPECT(withoutFeedback == 0.0f);
+		EXPECT(withFeedback >= 0.0f && withFeedback < 1.0e-6f);
+	}
+
+	std::printf("render_farm: %d failure(s)\n", testFailures);
+	return testFailures == 0 ? 0 : 1;
+}
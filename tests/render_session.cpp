@@ -0,0 +1,82 @@
+/***************************************************************************************
+Checks the editable render of RenderSession: a file longer than an AudioBuffer can hold is
+refused before anything is allocated, and a rerender after an automation edit ends with the
+same output as a fresh render of the edited automation.
+****************************************************************************************/
+
+#include "Flanger.h"
+#include "RenderSession.h"
+#include "TestUtilities.h"
+
+#include <limits>
+
+#define TEST_SAMPLE_RATE 44100.0
+#define TEST_LENGTH (6 * 44100 + 77)
+#define TEST_CHECKPOINT_INTERVAL 44100
+#define TEST_MAX_DELAY 300
+
+static void initializeFlanger(Flanger& flanger)
+{
+	flanger.initialize(DEFAULT_SESSION_BLOCK_SIZE, TEST_SAMPLE_RATE);
+	flanger.setDepth(0.7f);
+	flanger.setLFO(1.0f);
+}
+
+
+//************* Depth automation: 0.7 everywhere, editedDepth from editStart to editEnd ********************************************//
+
+static std::function<void(int64)> depthAutomation(Flanger& flanger, float editedDepth, int64 editStart, int64 editEnd)
+{
+	return [&flanger, editedDepth, editStart, editEnd] (int64 position)
+	{
+		flanger.setDepth(position >= editStart && position < editEnd ? editedDepth : 0.7f);
+	};
+}
+
+
+int main()
+{
+	{
+		TestSignalReader reader(2, static_cast<int64>(std::numeric_limits<int>::max()) + 1, TEST_SAMPLE_RATE);
+		Flanger flanger;
+		initializeFlanger(flanger);
+
+		RenderSession<Flanger> session(reader, TEST_CHECKPOINT_INTERVAL, makeChainStage(flanger, TEST_MAX_DELAY, 1.0f));
+		EXPECT(! session.render());
+		EXPECT(session.getOutput().getNumSamples() == 0);
+	}
+
+	const int64 editStart = 2 * 44100 + 1000, editEnd = 3 * 44100;
+	TestSignalReader reader(2, TEST_LENGTH, TEST_SAMPLE_RATE);
+
+	Flanger edited;
+	initializeFlanger(edited);
+	RenderSession<Flanger> session(reader, TEST_CHECKPOINT_INTERVAL, makeChainStage(edited, TEST_MAX_DELAY, 1.0f));
+	session.setAutomation(depthAutomation(edited, 0.7f, editStart, editEnd));
+	EXPECT(session.render());
+
+	session.setAutomation(depthAutomation(edited, 0.2f, editStart, editEnd));
+	EXPECT(session.rerender(editStart, editEnd));
+	EXPECT(session.getLastRenderedRange().start <= editStart && session.getLastRenderedRange().end >= editEnd);
+
+	Flanger fresh;
+	initializeFlanger(fresh);
+	RenderSession<Flanger> reference(reader, TEST_CHECKPOINT_INTERVAL, makeChainStage(fresh, TEST_MAX_DELAY, 1.0f));
+	reference.setAutomation(depthAutomation(fresh, 0.2f, editStart, editEnd));
+	EXPECT(reference.render());
+
+	const AudioBuffer<float>& output = session.getOutput();
+	const AudioBuffer<float>& expected = reference.getOutput();
+	EXPECT(output.getNumSamples() == TEST_LENGTH && expected.getNumSamples() == TEST_LENGTH);
+
+	bool identical = true;
+
+	for (auto channel = 0; channel < 2; ++channel)
+		for (auto i = 0; i < jmin(output.getNumSamples(), expected.getNumSamples()); ++i)
+			identical = identical && output.getSample(channel, i) == expected.getSample(channel, i);
+
+	EXPECT(identical);
+
+	std::printf("render_session: %d failure(s)\n", testFailures);
+	return testFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,142 @@
+/***************************************************************************************
+Saves the running state of a Flanger and a PitchShifter in the middle of a render, restores it
+into a fresh instance and checks that both render the following blocks bit for bit the same.
+The fresh instance is initialized for another block size, which the state must not depend on.
+Blobs from an instance with another channel count or sample rate must be rejected.
+****************************************************************************************/
+
+#include "Flanger.h"
+#include "PitchShifter.h"
+#include "TestUtilities.h"
+
+#include <cstring>
+
+#define TEST_BLOCK_SIZE 256
+#define TEST_CHANNELS 2
+#define TEST_SAMPLE_RATE 44100.0
+#define TEST_BLOCKS_BEFORE_SAVE 37			// N, leaves the rings and the LFOs somewhere in the middle
+#define TEST_BLOCKS_AFTER_SAVE 25			// M
+
+//************* Renders numBlocks blocks of the test signal from stream position position on and appends the output to output *****//
+
+template <typename Effect>
+static void render(Effect& effect, int numChannels, int64 position, int numBlocks, std::vector<float>& output)
+{
+	AudioBuffer<float> buffer(numChannels, TEST_BLOCK_SIZE);
+
+	for (auto block = 0; block < numBlocks; ++block, position += TEST_BLOCK_SIZE)
+	{
+		fillTestSignal(buffer, 0, TEST_BLOCK_SIZE, position);
+
+		for (auto channel = 0; channel < numChannels; ++channel)
+			effect.process(&buffer, 0, TEST_BLOCK_SIZE, 300, channel, 0.9f);
+
+		effect.adjustWritePositions(TEST_BLOCK_SIZE);
+
+		for (auto channel = 0; channel < numChannels; ++channel)
+			output.insert(output.end(), buffer.getReadPointer(channel), buffer.getReadPointer(channel) + TEST_BLOCK_SIZE);
+	}
+}
+
+
+//************* N blocks, save, M blocks; then restore into a fresh instance and render the same M blocks. configure() sets the ***//
+//************* parameters, which are not part of the state. ***************************************************************************//
+
+template <typename Effect, typename Configure>
+static void checkRoundTrip(const char* name, Configure configure)
+{
+	Effect original;
+	original.initialize(2 * TEST_BLOCK_SIZE, TEST_SAMPLE_RATE, TEST_CHANNELS);
+	configure(original);
+
+	std::vector<float> output;
+	render(original, TEST_CHANNELS, 0, TEST_BLOCKS_BEFORE_SAVE, output);
+
+	std::vector<char> state(original.getStateSize());
+	EXPECT(original.saveState(state.data(), state.size() - 1) == 0);
+	EXPECT(original.saveState(state.data(), state.size()) == state.size());
+
+	std::vector<float> expected;
+	render(original, TEST_CHANNELS, static_cast<int64>(TEST_BLOCKS_BEFORE_SAVE) * TEST_BLOCK_SIZE, TEST_BLOCKS_AFTER_SAVE, expected);
+
+	Effect restored;
+	restored.initialize(TEST_BLOCK_SIZE, TEST_SAMPLE_RATE, TEST_CHANNELS);
+	configure(restored);
+	EXPECT(restored.restoreState(state.data(), state.size()));
+
+	std::vector<float> actual;
+	render(restored, TEST_CHANNELS, static_cast<int64>(TEST_BLOCKS_BEFORE_SAVE) * TEST_BLOCK_SIZE, TEST_BLOCKS_AFTER_SAVE, actual);
+
+	EXPECT(actual.size() == expected.size());
+	EXPECT(std::memcmp(actual.data(), expected.data(), sizeof(float) * expected.size()) == 0);
+
+	// without the restore, the fresh instance would not match: the check above is not trivially true
+
+	Effect unrestored;
+	unrestored.initialize(TEST_BLOCK_SIZE, TEST_SAMPLE_RATE, TEST_CHANNELS);
+	configure(unrestored);
+
+	std::vector<float> unrestoredOutput;
+	render(unrestored, TEST_CHANNELS, static_cast<int64>(TEST_BLOCKS_BEFORE_SAVE) * TEST_BLOCK_SIZE, TEST_BLOCKS_AFTER_SAVE, unrestoredOutput);
+	EXPECT(std::memcmp(unrestoredOutput.data(), expected.data(), sizeof(float) * expected.size()) != 0);
+
+	// another channel count or sample rate: rejected, the state is left untouched
+
+	Effect mono;
+	mono.initialize(TEST_BLOCK_SIZE, TEST_SAMPLE_RATE, 1);
+	EXPECT(! mono.restoreState(state.data(), state.size()));
+
+	Effect otherRate;
+	otherRate.initialize(TEST_BLOCK_SIZE, 48000.0, TEST_CHANNELS);
+	EXPECT(! otherRate.restoreState(state.data(), state.size()));
+
+	Effect rejecting;
+	rejecting.initialize(TEST_BLOCK_SIZE, TEST_SAMPLE_RATE, TEST_CHANNELS);
+	configure(rejecting);
+	std::vector<char> corrupted(state);
+	corrupted[0] ^= 1;					// the magic number
+	EXPECT(! rejecting.restoreState(corrupted.data(), corrupted.size()));
+
+	std::vector<float> rejectingOutput;
+	render(rejecting, TEST_CHANNELS, static_cast<int64>(TEST_BLOCKS_BEFORE_SAVE) * TEST_BLOCK_SIZE, TEST_BLOCKS_AFTER_SAVE, rejectingOutput);
+	EXPECT(rejectingOutput == unrestoredOutput);
+
+	std::printf("%s: %d failure(s) so far\n", name, testFailures);
+}
+
+
+int main()
+{
+	checkRoundTrip<Flanger>("Flanger", [] (Flanger& flanger)
+	{
+		flanger.setDepth(0.7f);
+		flanger.setLFO(0.8f);
+		flanger.setFeedback(0.6f);
+		flanger.setFeedbackDamping(0.3f);
+		flanger.setFeedbackSaturation(true);
+	});
+
+	checkRoundTrip<Flanger>("Flanger at control rate 16", [] (Flanger& flanger)
+	{
+		flanger.setDepth(0.5f);
+		flanger.setLFO(1.3f);
+		flanger.setFeedback(0.4f);
+		flanger.setControlRate(16);
+	});
+
+	checkRoundTrip<PitchShifter>("PitchShifter", [] (PitchShifter& pitchShifter)
+	{
+		pitchShifter.setLevel(20.0f);
+		pitchShifter.setUp();
+	});
+
+	checkRoundTrip<PitchShifter>("PitchShifter at control rate 32", [] (PitchShifter& pitchShifter)
+	{
+		pitchShifter.setLevel(7.0f);
+		pitchShifter.setDown();
+		pitchShifter.setControlRate(32);
+	});
+
+	std::printf("state_round_trip: %d failure(s)\n", testFailures);
+	return testFailures == 0 ? 0 : 1;
+}